@@ -0,0 +1,96 @@
+#include "Census.h"
+#include "ChunkKey.h"
+#include <algorithm>
+#include <format>
+#include <vector>
+
+namespace tps_item_optimizer {
+
+size_t CensusSnapshot::ageBucket(std::uint64_t ageTicks) {
+    static constexpr std::uint64_t bounds[kAgeBuckets - 1] = {600, 1200, 3000, 6000};
+    size_t                         b                       = 0;
+    while (b < kAgeBuckets - 1 && ageTicks >= bounds[b]) ++b;
+    return b;
+}
+
+namespace {
+
+template <class Map>
+auto topEntries(Map const& map, size_t n) {
+    std::vector<std::pair<typename Map::key_type, std::uint32_t>> entries(map.begin(), map.end());
+    n = std::min(n, entries.size());
+    std::partial_sort(
+        entries.begin(),
+        entries.begin() + static_cast<std::ptrdiff_t>(n),
+        entries.end(),
+        [](auto const& a, auto const& b) { return a.second > b.second; }
+    );
+    entries.resize(n);
+    return entries;
+}
+
+} // namespace
+
+std::string CensusSnapshot::format(size_t topN) const {
+    std::string out = std::format(
+        "Census @{} ({} ticks): entities={}, items={}, types={}, chunks={}",
+        tick, walkTicks, entities, stackItems, byType.size(), byChunk.size()
+    );
+    out += std::format(
+        "\nstate: resting={} moving={} liquid={}",
+        byMotion[static_cast<size_t>(ItemMotion::Resting)],
+        byMotion[static_cast<size_t>(ItemMotion::Moving)],
+        byMotion[static_cast<size_t>(ItemMotion::Liquid)]
+    );
+    out += "\ndimension:";
+    for (auto const& [dim, n] : byDimension) out += std::format(" {}={}", dim, n);
+    out += std::format(
+        "\nage: <30s={} <1m={} <2.5m={} <5m={} >=5m={}",
+        byAge[0], byAge[1], byAge[2], byAge[3], byAge[4]
+    );
+    out += "\ntop types:";
+    for (auto const& [type, n] : topEntries(byType, topN)) out += std::format(" {}={}", type, n);
+    out += "\ntop chunks:";
+    for (auto const& [chunk, n] : topEntries(byChunk, topN)) {
+        out += std::format(" [{}]({}, {})={}", chunkKeyDim(chunk), chunkKeyX(chunk), chunkKeyZ(chunk), n);
+    }
+    return out;
+}
+
+void CensusBuilder::begin(std::uint64_t tick) {
+    mBuilding  = std::make_unique<CensusSnapshot>();
+    mStartTick = tick;
+}
+
+void CensusBuilder::add(
+    std::string const& type,
+    ItemMotion         motion,
+    int                dim,
+    std::uint64_t      ageTicks,
+    std::uint64_t      chunk,
+    int                count
+) {
+    if (!mBuilding) return;
+    auto& s = *mBuilding;
+    ++s.entities;
+    s.stackItems += static_cast<size_t>(count);
+    ++s.byType[type];
+    ++s.byMotion[static_cast<size_t>(motion)];
+    ++s.byDimension[dim];
+    ++s.byAge[CensusSnapshot::ageBucket(ageTicks)];
+    ++s.byChunk[chunk];
+}
+
+void CensusBuilder::publish(std::uint64_t tick) {
+    if (!mBuilding) return;
+    mBuilding->tick      = tick;
+    mBuilding->walkTicks = tick - mStartTick;
+    mPublished           = std::shared_ptr<CensusSnapshot const>(std::move(mBuilding));
+}
+
+void CensusBuilder::reset() {
+    mBuilding.reset();
+    mPublished.reset();
+}
+
+} // namespace tps_item_optimizer
@@ -0,0 +1,56 @@
+#pragma once
+#include "Rules.h"
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace tps_item_optimizer {
+
+// 一次完整遍历得到的地面掉落物统计，发布后只读
+struct CensusSnapshot {
+    static constexpr size_t kAgeBuckets = 5; // <30s, <1m, <2.5m, <5m, >=5m
+
+    std::uint64_t tick       = 0; // 完成时的 tick
+    std::uint64_t walkTicks  = 0; // 本次遍历跨越的 tick 数
+    size_t        entities   = 0;
+    size_t        stackItems = 0; // 物品总个数（堆叠数之和）
+
+    std::unordered_map<std::string, std::uint32_t>                  byType;
+    std::array<std::uint32_t, static_cast<size_t>(ItemMotion::Count)> byMotion{};
+    std::map<int, std::uint32_t>                                     byDimension;
+    std::array<std::uint32_t, kAgeBuckets>                           byAge{};
+    std::unordered_map<std::uint64_t, std::uint32_t>                 byChunk;
+
+    static size_t ageBucket(std::uint64_t ageTicks);
+
+    [[nodiscard]] std::string format(size_t topN) const;
+};
+
+// 增量构建：每 tick 喂入有限个掉落物，完成后原子地替换已发布的快照
+class CensusBuilder {
+public:
+    void begin(std::uint64_t tick);
+    void add(
+        std::string const& type,
+        ItemMotion         motion,
+        int                dim,
+        std::uint64_t      ageTicks,
+        std::uint64_t      chunk,
+        int                count
+    );
+    void publish(std::uint64_t tick);
+
+    [[nodiscard]] std::shared_ptr<CensusSnapshot const> latest() const { return mPublished; }
+
+    void reset();
+
+private:
+    std::unique_ptr<CensusSnapshot>       mBuilding;
+    std::uint64_t                         mStartTick = 0;
+    std::shared_ptr<CensusSnapshot const> mPublished;
+};
+
+} // namespace tps_item_optimizer
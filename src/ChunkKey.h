@@ -0,0 +1,56 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+namespace tps_item_optimizer {
+
+// 维度 + 区块坐标打包为 64 位键：维度 8 位，x/z 各 28 位（有符号）
+inline std::uint64_t packChunkKey(int dim, int cx, int cz) {
+    constexpr std::uint64_t mask = (std::uint64_t{1} << 28) - 1;
+    return (static_cast<std::uint64_t>(dim & 0xFF) << 56) | ((static_cast<std::uint64_t>(cx) & mask) << 28)
+         | (static_cast<std::uint64_t>(cz) & mask);
+}
+
+inline std::uint64_t chunkKeyAt(int dim, double x, double z) {
+    return packChunkKey(dim, static_cast<int>(std::floor(x)) >> 4, static_cast<int>(std::floor(z)) >> 4);
+}
+
+inline int chunkKeyDim(std::uint64_t key) { return static_cast<int>(key >> 56); }
+
+inline int chunkKeyX(std::uint64_t key) {
+    // 28 位符号扩展
+    return static_cast<int>(static_cast<std::int64_t>(key << 8) >> 36);
+}
+
+inline int chunkKeyZ(std::uint64_t key) { return static_cast<int>(static_cast<std::int64_t>(key << 36) >> 36); }
+
+// 方块坐标打包：x/z 各 26 位，y 12 位（均有符号）
+inline std::uint64_t packBlockKey(int x, int y, int z) {
+    return (static_cast<std::uint64_t>(x) & 0x3FFFFFF) << 38 | (static_cast<std::uint64_t>(z) & 0x3FFFFFF) << 12
+         | (static_cast<std::uint64_t>(y) & 0xFFF);
+}
+
+inline int blockKeyX(std::uint64_t key) { return static_cast<int>(static_cast<std::int64_t>(key) >> 38); }
+inline int blockKeyZ(std::uint64_t key) { return static_cast<int>(static_cast<std::int64_t>(key << 26) >> 38); }
+inline int blockKeyY(std::uint64_t key) { return static_cast<int>(static_cast<std::int64_t>(key << 52) >> 52); }
+
+// Morton 序：三个坐标各取 21 位交错，排序后空间上相邻的格子大多也相邻
+inline std::uint64_t spreadBits21(std::uint64_t v) {
+    v &= 0x1FFFFF;
+    v  = (v | v << 32) & 0x1F00000000FFFFull;
+    v  = (v | v << 16) & 0x1F0000FF0000FFull;
+    v  = (v | v << 8) & 0x100F00F00F00F00Full;
+    v  = (v | v << 4) & 0x10C30C30C30C30C3ull;
+    v  = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+}
+
+// 有符号坐标先偏移到非负
+inline std::uint64_t mortonKey(int x, int y, int z) {
+    constexpr std::int64_t bias = 1 << 20;
+    return spreadBits21(static_cast<std::uint64_t>(x + bias))
+         | spreadBits21(static_cast<std::uint64_t>(y + bias)) << 1
+         | spreadBits21(static_cast<std::uint64_t>(z + bias)) << 2;
+}
+
+} // namespace tps_item_optimizer
@@ -0,0 +1,50 @@
+#include "Optimizer.h"
+#include "SuperStacks.h"
+#include "VirtualItems.h"
+#include <ll/api/command/Command.h>
+#include <ll/api/command/CommandHandle.h>
+#include <ll/api/command/CommandRegistrar.h>
+#include <mc/server/commands/CommandOrigin.h>
+#include <mc/server/commands/CommandOutput.h>
+#include <mc/server/commands/CommandPermissionLevel.h>
+
+namespace tps_item_optimizer {
+
+// /tpsitem <报告名>：查询运行期统计
+void registerCommand() {
+    static bool registered = false;
+    if (registered) return;
+    registered = true;
+
+    auto& cmd = ll::command::CommandRegistrar::getInstance().getOrCreateCommand(
+        "tpsitem",
+        "TpsItemOptimizer reports",
+        CommandPermissionLevel::GameDirectors
+    );
+    cmd.overload().text("fairness").execute([](CommandOrigin const&, CommandOutput& output) {
+        output.success(fairnessReport());
+    });
+    cmd.overload().text("census").execute([](CommandOrigin const&, CommandOutput& output) {
+        output.success(censusReport());
+    });
+    cmd.overload().text("chunks").execute([](CommandOrigin const&, CommandOutput& output) {
+        output.success(chunkCostReport());
+    });
+    cmd.overload().text("types").execute([](CommandOrigin const&, CommandOutput& output) {
+        output.success(typeCostReport());
+    });
+    cmd.overload().text("flow").execute([](CommandOrigin const&, CommandOutput& output) {
+        output.success(flowReport());
+    });
+    cmd.overload().text("batch").execute([](CommandOrigin const&, CommandOutput& output) {
+        output.success(batchReport());
+    });
+    cmd.overload().text("virtual").execute([](CommandOrigin const&, CommandOutput& output) {
+        output.success(virtualItemsReport());
+    });
+    cmd.overload().text("stacks").execute([](CommandOrigin const&, CommandOutput& output) {
+        output.success(superStackReport());
+    });
+}
+
+} // namespace tps_item_optimizer
@@ -0,0 +1,194 @@
+#include "Controller.h"
+#include <algorithm>
+#include <cmath>
+
+namespace tps_item_optimizer {
+
+void clampControlState(ControlState& state) {
+    state.maxPerTick    = std::clamp(state.maxPerTick, double(kMinPerTick), double(kMaxPerTick));
+    state.cooldownTicks = std::clamp(state.cooldownTicks, double(kMinCooldown), double(kMaxCooldown));
+}
+
+OscillationDetector::OscillationDetector(OscillationParams const& params)
+: mParams(params),
+  mErrors(static_cast<size_t>(std::max(params.window, 4)), 0.0) {}
+
+OscillationDetector::Event OscillationDetector::update(double errorMs) {
+    mErrors[mHead] = errorMs;
+    mHead          = (mHead + 1) % mErrors.size();
+    if (mFilled < mErrors.size()) {
+        ++mFilled;
+        return Event::None;
+    }
+
+    int    crossings = 0;
+    double amplitude = 0.0;
+    for (size_t i = 0; i < mErrors.size(); ++i) {
+        double cur  = mErrors[(mHead + i) % mErrors.size()];
+        amplitude  += std::abs(cur);
+        if (i > 0) {
+            double prev = mErrors[(mHead + i - 1) % mErrors.size()];
+            if ((prev > 0.0) != (cur > 0.0)) ++crossings;
+        }
+    }
+    mCrossingRate = static_cast<double>(crossings) / static_cast<double>(mErrors.size() - 1);
+    mAmplitudeMs  = amplitude / static_cast<double>(mErrors.size());
+
+    if (mCrossingRate >= mParams.crossingRate && mAmplitudeMs >= mParams.minAmplitudeMs) {
+        mCalm = 0;
+        if (mGainScale <= mParams.minGainScale && mDeadbandMs >= mParams.maxDeadbandMs) return Event::None;
+        mGainScale  = std::max(mParams.minGainScale, mGainScale * 0.5);
+        mDeadbandMs = std::min(mParams.maxDeadbandMs, mDeadbandMs + mParams.deadbandStepMs);
+        // 清空窗口，观察调整后的效果
+        mFilled = 0;
+        return Event::Damped;
+    }
+
+    if (mGainScale >= 1.0 && mDeadbandMs <= 0.0) return Event::None;
+    if (++mCalm < mParams.calmTicks) return Event::None;
+    mCalm       = 0;
+    mGainScale  = std::min(1.0, mGainScale * 2.0);
+    mDeadbandMs = std::max(0.0, mDeadbandMs - mParams.deadbandStepMs);
+    return Event::Restored;
+}
+
+void OscillationDetector::restore(double gainScale, double deadbandMs) {
+    mGainScale  = std::clamp(gainScale, mParams.minGainScale, 1.0);
+    mDeadbandMs = std::clamp(deadbandMs, 0.0, mParams.maxDeadbandMs);
+}
+
+void WorldSpikeFilter::restore(double baselineMs) {
+    if (baselineMs <= 0.0) return;
+    mBaselineMs = baselineMs;
+    mPrimed     = true;
+}
+
+bool WorldSpikeFilter::update(double otherMs) {
+    if (!mPrimed) {
+        mBaselineMs = otherMs;
+        mPrimed     = true;
+        return false;
+    }
+    bool spike = otherMs > mBaselineMs * mParams.factor && otherMs - mBaselineMs > mParams.minMs;
+    if (spike && ++mRun <= mParams.maxRun) return true;
+    mRun         = spike ? mRun : 0;
+    mBaselineMs += 0.05 * (otherMs - mBaselineMs);
+    return false;
+}
+
+double feedforwardMs(FeedforwardParams const& params, double spawnRate, double growthRate, double itemCostMs) {
+    if (itemCostMs <= 0.0) return 0.0;
+    // 新生成的掉落物首次出现即放行；数量在增长时积压即将形成，减少时不放松（交给反馈）
+    return itemCostMs * (params.countGain * std::max(0.0, growthRate) + params.spawnGain * spawnRate);
+}
+
+namespace {
+
+// 固定步长：超标收紧一步，达标放宽一步
+class StepController final : public Controller {
+public:
+    explicit StepController(ControlParams const& p) : mParams(p) {}
+
+    [[nodiscard]] std::string_view name() const override { return "step"; }
+
+    void update(ControlInput const& in, ControlState& state) override {
+        double error = in.errorMs();
+        if (std::abs(error) <= in.deadbandMs) return;
+        double perTick  = mParams.perTickStep * in.gainScale;
+        double cooldown = mParams.cooldownStep * in.gainScale;
+        if (error > 0.0) {
+            state.maxPerTick    -= perTick;
+            state.cooldownTicks += cooldown;
+        } else {
+            state.maxPerTick    += perTick;
+            state.cooldownTicks -= cooldown;
+        }
+        clampControlState(state);
+    }
+
+private:
+    ControlParams mParams;
+};
+
+// 加性增、乘性减：尖峰时快速退让
+class AimdController final : public Controller {
+public:
+    explicit AimdController(ControlParams const& p) : mParams(p) {}
+
+    [[nodiscard]] std::string_view name() const override { return "aimd"; }
+
+    void update(ControlInput const& in, ControlState& state) override {
+        double error = in.errorMs();
+        if (std::abs(error) <= in.deadbandMs) return;
+        if (error > 0.0) {
+            // 增益缩小时乘性减也相应变缓
+            state.maxPerTick    *= 1.0 - (1.0 - mParams.aimdDecrease) * in.gainScale;
+            state.cooldownTicks += mParams.cooldownStep * in.gainScale;
+        } else {
+            state.maxPerTick    += mParams.perTickStep * in.gainScale;
+            state.cooldownTicks -= mParams.cooldownStep * in.gainScale;
+        }
+        clampControlState(state);
+    }
+
+private:
+    ControlParams mParams;
+};
+
+// 简单模型预测：tickMs ≈ 非掉落物耗时 + 放行数 × 单个耗时，
+// 求出恰好落在目标内的放行数，再按掉落物总数规划冷却
+class MpcController final : public Controller {
+public:
+    explicit MpcController(ControlParams const& p) : mParams(p) {}
+
+    [[nodiscard]] std::string_view name() const override { return "mpc"; }
+
+    void update(ControlInput const& in, ControlState& state) override {
+        if (in.itemCostMs <= 0.0) {
+            // 尚未学到耗时，保守地按固定步长走
+            StepController{mParams}.update(in, state);
+            return;
+        }
+        double otherMs = std::max(0.0, in.tickMs - in.processed * in.itemCostMs);
+        mOtherMs       = mPrimed ? mOtherMs + mParams.mpcSmoothing * (otherMs - mOtherMs) : otherMs;
+        mPrimed        = true;
+
+        if (std::abs(in.errorMs()) <= in.deadbandMs) return;
+
+        double plan       = (in.targetMs - mOtherMs - in.feedforwardMs) / in.itemCostMs;
+        state.maxPerTick += mParams.mpcSmoothing * in.gainScale * (plan - state.maxPerTick);
+        clampControlState(state);
+
+        // 每个掉落物每 cooldown tick 需要一次放行
+        if (in.itemCount > 0) {
+            state.cooldownTicks = std::ceil(static_cast<double>(in.itemCount) / state.maxPerTick);
+        }
+        clampControlState(state);
+    }
+
+    [[nodiscard]] std::vector<double> exportModel() const override {
+        if (!mPrimed) return {};
+        return {mOtherMs};
+    }
+
+    void importModel(std::vector<double> const& model) override {
+        if (model.empty() || model[0] < 0.0) return;
+        mOtherMs = model[0];
+        mPrimed  = true;
+    }
+
+private:
+    ControlParams mParams;
+    double        mOtherMs = 0.0;
+    bool          mPrimed  = false;
+};
+
+} // namespace
+
+std::unique_ptr<Controller> makeController(std::string_view name, ControlParams const& params) {
+    if (name == "aimd") return std::make_unique<AimdController>(params);
+    if (name == "mpc") return std::make_unique<MpcController>(params);
+    return std::make_unique<StepController>(params);
+}
+
+} // namespace tps_item_optimizer
@@ -0,0 +1,136 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <string_view>
+
+namespace tps_item_optimizer {
+
+// 动态参数上下限
+inline constexpr int kMinPerTick  = 8;
+inline constexpr int kMaxPerTick  = 200;
+inline constexpr int kMinCooldown = 1;
+inline constexpr int kMaxCooldown = 10;
+
+// 每个 Level tick 结束后交给控制器的观测值
+struct ControlInput {
+    double tickMs     = 0.0; // 本 tick 总耗时
+    double targetMs   = 50.0;
+    int    processed  = 0;   // 本 tick 放行的掉落物数
+    size_t itemCount  = 0;   // 当前跟踪的掉落物数
+    double itemCostMs = 0.0; // 学习到的单个掉落物 tick 耗时
+
+    // 前馈项：根据掉落物数量与生成速率预测的额外耗时，与反馈误差相加
+    double feedforwardMs = 0.0;
+
+    // 增益调度：由振荡检测器给出
+    double gainScale  = 1.0; // 步长缩放
+    double deadbandMs = 0.0; // |误差| 不超过死区时保持不动
+
+    [[nodiscard]] double errorMs() const { return tickMs + feedforwardMs - targetMs; }
+};
+
+// 控制器输出，保留小数以便小步长累积
+struct ControlState {
+    double maxPerTick    = 20.0;
+    double cooldownTicks = 2.0;
+};
+
+struct ControlParams {
+    int    perTickStep  = 2;
+    int    cooldownStep = 1;
+    double aimdDecrease = 0.5;
+    double mpcSmoothing = 0.3;
+};
+
+class Controller {
+public:
+    virtual ~Controller() = default;
+
+    [[nodiscard]] virtual std::string_view name() const = 0;
+
+    virtual void update(ControlInput const& in, ControlState& state) = 0;
+
+    // 学到的模型参数，用于跨重启持久化
+    [[nodiscard]] virtual std::vector<double> exportModel() const { return {}; }
+    virtual void                              importModel(std::vector<double> const&) {}
+};
+
+// name: "step" | "aimd" | "mpc"，未知名称回退到 step
+std::unique_ptr<Controller> makeController(std::string_view name, ControlParams const& params);
+
+void clampControlState(ControlState& state);
+
+struct OscillationParams {
+    int    window          = 40;   // 观察窗口（tick）
+    double crossingRate    = 0.35; // 误差过零次数 / 窗口，超过即视为振荡
+    double minAmplitudeMs  = 2.0;  // 平均 |误差| 低于此值的抖动忽略
+    int    calmTicks       = 200;  // 持续平稳多少 tick 后逐级恢复增益
+    double minGainScale    = 0.125;
+    double deadbandStepMs  = 1.0;
+    double maxDeadbandMs   = 5.0;
+};
+
+// 在线振荡检测：按 MSPT 误差的过零率与幅度判断，振荡时减半增益并加宽死区，平稳后逐级恢复
+class OscillationDetector {
+public:
+    enum class Event { None, Damped, Restored };
+
+    explicit OscillationDetector(OscillationParams const& params);
+
+    Event update(double errorMs);
+
+    [[nodiscard]] double gainScale() const { return mGainScale; }
+    [[nodiscard]] double deadbandMs() const { return mDeadbandMs; }
+    [[nodiscard]] double crossingRate() const { return mCrossingRate; }
+    [[nodiscard]] double amplitudeMs() const { return mAmplitudeMs; }
+
+    void restore(double gainScale, double deadbandMs);
+
+private:
+    OscillationParams   mParams;
+    std::vector<double> mErrors;
+    size_t              mHead         = 0;
+    size_t              mFilled       = 0;
+    int                 mCalm         = 0;
+    double              mGainScale    = 1.0;
+    double              mDeadbandMs   = 0.0;
+    double              mCrossingRate = 0.0;
+    double              mAmplitudeMs  = 0.0;
+};
+
+struct SpikeFilterParams {
+    double factor = 2.0;  // 非掉落物耗时超过基线的倍数
+    double minMs  = 15.0; // 且至少高出基线的毫秒数
+    int    maxRun = 100;  // 连续超过此 tick 数视为新常态，不再排除
+};
+
+// 按时间特征识别与掉落物无关的尖峰（自动存档、区块生成、命令方块刷屏等），
+// 这些 tick 不作为控制器输入
+class WorldSpikeFilter {
+public:
+    explicit WorldSpikeFilter(SpikeFilterParams const& params) : mParams(params) {}
+
+    // otherMs：本 tick 总耗时减去掉落物耗时；返回 true 表示应排除此 tick
+    bool update(double otherMs);
+
+    [[nodiscard]] double baselineMs() const { return mBaselineMs; }
+
+    void restore(double baselineMs);
+
+private:
+    SpikeFilterParams mParams;
+    double            mBaselineMs = 0.0;
+    bool              mPrimed     = false;
+    int               mRun        = 0;
+};
+
+struct FeedforwardParams {
+    double countGain = 0.5; // 掉落物数量每 tick 的净增长
+    double spawnGain = 1.0; // 每 tick 真实生成的掉落物数
+};
+
+// 预测即将到来的额外耗时（毫秒）。输入只取自世界本身（生成 hook 的计数与实体数的变化），
+// 不含控制器自己的额度，避免输出经前馈回到输入
+double feedforwardMs(FeedforwardParams const& params, double spawnRate, double growthRate, double itemCostMs);
+
+} // namespace tps_item_optimizer
@@ -0,0 +1,19 @@
+#pragma once
+#include <filesystem>
+#include <system_error>
+#include <ll/api/Config.h>
+
+namespace tps_item_optimizer {
+
+// 数据目录中的状态文件：先写临时文件再替换，崩溃时不会留下半截的文件
+template <class T>
+bool saveDataFile(T const& data, std::filesystem::path const& path) {
+    auto            temp = std::filesystem::path{path}.replace_extension(".tmp");
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    if (!ll::config::saveConfig(data, temp)) return false;
+    std::filesystem::rename(temp, path, ec);
+    return !ec;
+}
+
+} // namespace tps_item_optimizer
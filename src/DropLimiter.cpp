@@ -0,0 +1,258 @@
+#include "DropLimiter.h"
+#include "ChunkKey.h"
+#include "Optimizer.h"
+#include <ll/api/memory/Hook.h>
+#include <mc/world/actor/item/ItemActor.h>
+#include <mc/world/item/ItemStack.h>
+#include <mc/world/level/BlockPos.h>
+#include <mc/world/level/BlockSource.h>
+#include <mc/world/level/Level.h>
+#include <mc/world/level/Spawner.h>
+#include <mc/world/level/block/Block.h>
+#include <algorithm>
+#include <format>
+#include <unordered_map>
+
+namespace tps_item_optimizer {
+
+namespace {
+
+struct Bucket {
+    double        tokens   = 0.0;
+    std::uint64_t lastTick = 0;
+    ActorUniqueID anchor{};     // 同来源最近一个正常生成的掉落物，超限的合并进它
+    bool          hasAnchor = false;
+};
+
+struct PendingSpawn {
+    SpawnSource   source;
+    std::uint64_t tick  = 0;
+    bool          merge = false;
+    ActorUniqueID anchor{};
+};
+
+std::unordered_map<std::uint64_t, Bucket>       playerBuckets;
+std::unordered_map<std::uint64_t, Bucket>       blockBuckets;
+std::unordered_map<std::uint64_t, Bucket>       chunkBuckets;
+std::unordered_map<ActorUniqueID, PendingSpawn> pendingSpawns;
+std::uint64_t                                   lastPruneTick = 0;
+size_t                                          pendingMerges = 0;
+bool                                            limiterActive = false;
+bool                                            limiterBypass = false;
+
+size_t exceededPlayer = 0;
+size_t exceededBlock  = 0;
+size_t exceededChunk  = 0;
+size_t mergedItems    = 0;
+size_t mergeFailed    = 0;
+
+// 补充后尝试取一个令牌，返回 false 表示超限
+bool take(Bucket& bucket, std::uint64_t tick, double perSecond, int burst) {
+    if (bucket.lastTick == 0) bucket.tokens = burst;
+    else bucket.tokens = std::min<double>(burst, bucket.tokens + perSecond / 20.0 * (tick - bucket.lastTick));
+    bucket.lastTick = tick;
+    if (bucket.tokens < 1.0) return false;
+    bucket.tokens -= 1.0;
+    return true;
+}
+
+// 令牌已回满且长时间无生成的桶可以丢弃
+void prune(std::unordered_map<std::uint64_t, Bucket>& buckets, std::uint64_t tick) {
+    std::erase_if(buckets, [tick](auto const& entry) { return tick - entry.second.lastTick > 1200; });
+}
+
+std::uint64_t findDispenser(BlockSource& region, Vec3 const& pos) {
+    static constexpr int offsets[7][3] = {
+        {0,  0,  0 },
+        {1,  0,  0 },
+        {-1, 0,  0 },
+        {0,  1,  0 },
+        {0,  -1, 0 },
+        {0,  0,  1 },
+        {0,  0,  -1}
+    };
+    BlockPos base{pos};
+    for (auto const& o : offsets) {
+        BlockPos    p{base.x + o[0], base.y + o[1], base.z + o[2]};
+        auto const& name = region.getBlock(p).getTypeName();
+        if (name == "minecraft:dispenser" || name == "minecraft:dropper") return packBlockKey(p.x, p.y, p.z);
+    }
+    return 0;
+}
+
+void onItemSpawned(BlockSource& region, ItemActor& item, Actor* spawner, Vec3 const& pos) {
+    auto const&   cfg  = getConfig();
+    std::uint64_t tick = item.getLevel().getCurrentServerTick().tickID;
+
+    if (tick - lastPruneTick > 6000) {
+        lastPruneTick = tick;
+        prune(playerBuckets, tick);
+        prune(blockBuckets, tick);
+        prune(chunkBuckets, tick);
+        // 生成后一直没被看到的（例如很快被移除）
+        std::erase_if(pendingSpawns, [tick](auto const& entry) {
+            if (tick - entry.second.tick <= 1200) return false;
+            if (entry.second.merge) --pendingMerges;
+            return true;
+        });
+    }
+
+    PendingSpawn pending;
+    pending.tick         = tick;
+    pending.source.chunk = chunkKeyAt(item.getDimensionId().id, pos.x, pos.z);
+    if (spawner && spawner->isPlayer()) {
+        pending.source.player = static_cast<std::uint64_t>(spawner->getOrCreateUniqueID().rawID);
+    } else {
+        pending.source.block = findDispenser(region, pos);
+    }
+
+    // 按最具体的来源选合并锚点：玩家 > 方块 > 区块
+    Bucket* exceeded = nullptr;
+    Bucket* buckets[3]{};
+    if (pending.source.player != 0) {
+        buckets[0] = &playerBuckets[pending.source.player];
+        if (!take(*buckets[0], tick, cfg.dropLimitPlayerPerSecond, cfg.dropLimitPlayerBurst)) {
+            exceeded = buckets[0];
+            ++exceededPlayer;
+        }
+    }
+    if (pending.source.block != 0) {
+        buckets[1] = &blockBuckets[pending.source.block];
+        if (!take(*buckets[1], tick, cfg.dropLimitBlockPerSecond, cfg.dropLimitBlockBurst)) {
+            if (!exceeded) exceeded = buckets[1];
+            ++exceededBlock;
+        }
+    }
+    buckets[2] = &chunkBuckets[pending.source.chunk];
+    if (!take(*buckets[2], tick, cfg.dropLimitChunkPerSecond, cfg.dropLimitChunkBurst)) {
+        if (!exceeded) exceeded = buckets[2];
+        ++exceededChunk;
+    }
+
+    auto const& id = item.getOrCreateUniqueID();
+    if (exceeded && exceeded->hasAnchor) {
+        pending.merge  = true;
+        pending.anchor = exceeded->anchor;
+        ++pendingMerges;
+    } else {
+        for (auto* b : buckets) {
+            if (!b) continue;
+            b->anchor    = id;
+            b->hasAnchor = true;
+        }
+    }
+    auto [it, inserted] = pendingSpawns.try_emplace(id, pending);
+    if (!inserted) {
+        if (it->second.merge) --pendingMerges;
+        it->second = pending;
+    }
+}
+
+} // namespace
+
+void setDropLimiterActive(bool active) {
+    limiterActive = active;
+    playerBuckets.clear();
+    blockBuckets.clear();
+    chunkBuckets.clear();
+    pendingSpawns.clear();
+    lastPruneTick  = 0;
+    pendingMerges  = 0;
+    exceededPlayer = exceededBlock = exceededChunk = 0;
+    mergedItems = mergeFailed = 0;
+}
+
+void setDropLimiterBypass(bool bypass) { limiterBypass = bypass; }
+
+bool mergeItemActors(ItemActor& from, ItemActor& into) {
+    ItemStack&       dst = into.item();
+    ItemStack const& src = from.item();
+    if (!dst.isStackable(src)) return false;
+    int total = static_cast<int>(dst.mCount) + static_cast<int>(src.mCount);
+    if (total > static_cast<int>(dst.getMaxStackSize())) return false;
+    dst.set(total);
+    from.remove();
+    return true;
+}
+
+bool hasPendingMerges() { return pendingMerges > 0; }
+
+bool mergeIfOverLimit(Actor& item, ActorUniqueID const& id) {
+    ActorUniqueID key   = id; // id 可能引用 item 自身的成员
+    auto          found = pendingSpawns.find(key);
+    if (found == pendingSpawns.end() || !found->second.merge) return false;
+    found->second.merge = false;
+    --pendingMerges;
+
+    // 合并会移除 item，移除 hook 可能已经删掉本条目，之后只按键删除，不再使用 found
+    Actor* anchor = item.getLevel().fetchEntity(found->second.anchor, false);
+    double radius = getConfig().dropMergeRadius;
+    if (anchor && anchor != &item && anchor->hasCategory(ActorCategory::Item)
+        && anchor->getDimensionId() == item.getDimensionId()
+        && anchor->getPosition().distanceToSqr(item.getPosition()) <= radius * radius
+        && mergeItemActors(static_cast<ItemActor&>(item), static_cast<ItemActor&>(*anchor)))
+    {
+        pendingSpawns.erase(key);
+        ++mergedItems;
+        return true;
+    }
+    ++mergeFailed;
+    return false;
+}
+
+bool takeSpawnSource(ActorUniqueID const& id, SpawnSource& source) {
+    auto found = pendingSpawns.find(id);
+    if (found == pendingSpawns.end()) return false;
+    source = found->second.source;
+    if (found->second.merge) --pendingMerges;
+    pendingSpawns.erase(found);
+    return true;
+}
+
+void forgetPendingSpawn(ActorUniqueID const& id) {
+    auto found = pendingSpawns.find(id);
+    if (found == pendingSpawns.end()) return;
+    if (found->second.merge) --pendingMerges;
+    pendingSpawns.erase(found);
+}
+
+std::string dropLimiterReport() {
+    std::string out = std::format(
+        "Drop limit: exceeded player={} block={} chunk={}, merged={}, mergeFailed={}, buckets={}/{}/{}",
+        exceededPlayer, exceededBlock, exceededChunk, mergedItems, mergeFailed,
+        playerBuckets.size(), blockBuckets.size(), chunkBuckets.size()
+    );
+    exceededPlayer = exceededBlock = exceededChunk = 0;
+    mergedItems = mergeFailed = 0;
+    return out;
+}
+
+} // namespace tps_item_optimizer
+
+// ── Spawner::spawnItem Hook：按来源限速 ─────────────────
+LL_AUTO_TYPE_INSTANCE_HOOK(
+    SpawnItemHook,
+    ll::memory::HookPriority::Normal,
+    Spawner,
+    &Spawner::spawnItem,
+    ItemActor*,
+    BlockSource&     region,
+    ItemStack const& inst,
+    Actor*           spawner,
+    Vec3 const&      pos,
+    int              throwTime
+) {
+    using namespace tps_item_optimizer;
+
+    ItemActor* item = origin(region, inst, spawner, pos, throwTime);
+    auto const& cfg = getConfig();
+    if (item && !limiterBypass) {
+        countItemSpawn(
+            item->getOrCreateUniqueID(),
+            chunkKeyAt(item->getDimensionId().id, pos.x, pos.z),
+            spawner && spawner->isPlayer()
+        );
+    }
+    if (item && limiterActive && !limiterBypass && cfg.dropLimit) onItemSpawned(region, *item, spawner, pos);
+    return item;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <mc/legacy/ActorUniqueID.h>
+#include <mc/world/actor/Actor.h>
+#include <mc/world/actor/item/ItemActor.h>
+
+namespace tps_item_optimizer {
+
+// 掉落物的生成来源，0 表示无此来源
+struct SpawnSource {
+    std::uint64_t player = 0; // 投掷的玩家
+    std::uint64_t block  = 0; // 相邻的发射器/投掷器方块
+    std::uint64_t chunk  = 0;
+};
+
+// 把 from 的物品堆叠并入 into 并移除 from；不可堆叠或放不下时不做任何改动
+bool mergeItemActors(ItemActor& from, ItemActor& into);
+
+void setDropLimiterActive(bool active);
+
+// 插件自身还原的掉落物不计入任何来源
+void setDropLimiterBypass(bool bypass);
+
+// 是否有生成时来源已超限、等待合并的掉落物
+bool hasPendingMerges();
+
+// 生成时来源已超限的掉落物，尝试合并进同来源的锚点掉落物。
+// 返回 true 表示已合并并移除，不应再 tick；合并不了的保留
+bool mergeIfOverLimit(Actor& item, ActorUniqueID const& id);
+
+// 掉落物开始被跟踪时取出其生成来源
+bool takeSpawnSource(ActorUniqueID const& id, SpawnSource& source);
+
+void forgetPendingSpawn(ActorUniqueID const& id);
+
+std::string dropLimiterReport();
+
+} // namespace tps_item_optimizer
@@ -0,0 +1,40 @@
+#include "FileWatcher.h"
+#include <condition_variable>
+#include <mutex>
+
+namespace tps_item_optimizer {
+
+static std::filesystem::file_time_type modifiedTime(std::filesystem::path const& path) {
+    std::error_code ec;
+    auto            time = std::filesystem::last_write_time(path, ec);
+    return ec ? std::filesystem::file_time_type::min() : time;
+}
+
+void FileWatcher::start(
+    std::filesystem::path     path,
+    std::chrono::milliseconds interval,
+    std::function<void()>     onChange
+) {
+    stop();
+    mThread = std::jthread([path = std::move(path), interval, onChange = std::move(onChange)](std::stop_token st) {
+        std::mutex                  mutex;
+        std::condition_variable_any cv;
+        auto                        last = modifiedTime(path);
+        std::unique_lock            lock(mutex);
+        // stop_token 请求停止时 wait_for 立即返回
+        while (!cv.wait_for(lock, st, interval, [] { return false; }) && !st.stop_requested()) {
+            auto now = modifiedTime(path);
+            if (now == last) continue;
+            last = now;
+            onChange();
+        }
+    });
+}
+
+void FileWatcher::stop() {
+    if (!mThread.joinable()) return;
+    mThread.request_stop();
+    mThread.join();
+}
+
+} // namespace tps_item_optimizer
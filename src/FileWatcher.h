@@ -0,0 +1,24 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <thread>
+
+namespace tps_item_optimizer {
+
+// 在后台线程上轮询文件修改时间，变化时在该线程上调用回调
+class FileWatcher {
+public:
+    ~FileWatcher() { stop(); }
+
+    // 以当前修改时间为基准开始监视；已在运行时先停止
+    void start(std::filesystem::path path, std::chrono::milliseconds interval, std::function<void()> onChange);
+    void stop();
+
+    [[nodiscard]] bool running() const { return mThread.joinable(); }
+
+private:
+    std::jthread mThread;
+};
+
+} // namespace tps_item_optimizer
@@ -0,0 +1,58 @@
+#include "FlowField.h"
+
+namespace tps_item_optimizer {
+
+void FlowField::learn(
+    std::uint64_t chunk,
+    std::uint64_t cell,
+    void const*   block,
+    Vec3 const&   velocity,
+    std::uint64_t tick
+) {
+    auto& c                = mChunks[chunk];
+    auto [found, inserted] = c.cells.try_emplace(cell, Cell{velocity, block, tick});
+    auto& entry            = found->second;
+    // 同一格的多次样本取滑动平均，单个掉落物残留的动量不会直接成为整格的流速
+    if (!inserted && entry.block == block && tick - entry.tick <= mMaxAge) {
+        entry.velocity = entry.velocity + (velocity - entry.velocity) * 0.5f;
+        entry.tick     = tick;
+    } else if (!inserted) {
+        entry = {velocity, block, tick};
+    }
+    c.lastLearned = tick;
+    ++mCounters.learned;
+}
+
+Vec3 const* FlowField::lookup(std::uint64_t chunk, std::uint64_t cell, void const* block, std::uint64_t tick) {
+    auto c = mChunks.find(chunk);
+    if (c == mChunks.end()) {
+        ++mCounters.misses;
+        return nullptr;
+    }
+    auto found = c->second.cells.find(cell);
+    if (found == c->second.cells.end() || tick - found->second.tick > mMaxAge) {
+        ++mCounters.misses;
+        return nullptr;
+    }
+    if (found->second.block != block) {
+        // 液体更新会波及相邻格的流向，整个区块重新学习
+        mChunks.erase(c);
+        ++mCounters.invalidated;
+        ++mCounters.misses;
+        return nullptr;
+    }
+    ++mCounters.hits;
+    return &found->second.velocity;
+}
+
+void FlowField::prune(std::uint64_t tick) {
+    std::erase_if(mChunks, [&](auto const& entry) { return tick - entry.second.lastLearned > mMaxAge; });
+}
+
+size_t FlowField::cells() const {
+    size_t n = 0;
+    for (auto const& [key, c] : mChunks) n += c.cells.size();
+    return n;
+}
+
+} // namespace tps_item_optimizer
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <mc/deps/core/math/Vec3.h>
+
+namespace tps_item_optimizer {
+
+// 按区块缓存的液体流场：方块格 -> 原版 tick 后掉落物的速度，同一格的样本取滑动平均。
+// 每格记下学习时的方块指针（液体高度等状态变化会换成另一个 Block），
+// 使用时不一致即视为该区块发生了液体更新，整块丢弃
+class FlowField {
+public:
+    struct Counters {
+        size_t learned     = 0;
+        size_t hits        = 0;
+        size_t misses      = 0;
+        size_t invalidated = 0; // 因方块变化丢弃的区块数
+    };
+
+    explicit FlowField(std::uint64_t maxAgeTicks = 200) : mMaxAge(maxAgeTicks) {}
+
+    void setMaxAge(std::uint64_t ticks) { mMaxAge = ticks; }
+
+    void learn(std::uint64_t chunk, std::uint64_t cell, void const* block, Vec3 const& velocity, std::uint64_t tick);
+
+    // 命中且方块未变化、未过期时返回速度，否则返回 nullptr
+    Vec3 const* lookup(std::uint64_t chunk, std::uint64_t cell, void const* block, std::uint64_t tick);
+
+    // 丢弃长时间未学习的区块
+    void prune(std::uint64_t tick);
+
+    void clear() { mChunks.clear(); }
+
+    [[nodiscard]] size_t    chunks() const { return mChunks.size(); }
+    [[nodiscard]] size_t    cells() const;
+    [[nodiscard]] Counters& counters() { return mCounters; }
+
+private:
+    struct Cell {
+        Vec3          velocity{};
+        void const*   block = nullptr;
+        std::uint64_t tick  = 0;
+    };
+
+    struct Chunk {
+        std::unordered_map<std::uint64_t, Cell> cells;
+        std::uint64_t                           lastLearned = 0;
+    };
+
+    std::unordered_map<std::uint64_t, Chunk> mChunks;
+    std::uint64_t                            mMaxAge;
+    Counters                                 mCounters;
+};
+
+} // namespace tps_item_optimizer
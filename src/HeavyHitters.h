@@ -0,0 +1,102 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace tps_item_optimizer {
+
+// 带衰减的加权 Space-Saving：固定 capacity 个槽位，跟踪权重最大的键。
+// 新键在满时顶替权重最小的槽位并继承其权重，继承部分记为误差上界；
+// 真实权重落在 [weight - error, weight] 之间；hits 只计进入槽位后的样本，
+// 平均权重为 (weight - error) / hits
+template <class Key>
+class HeavyHitters {
+public:
+    struct Entry {
+        Key    key{};
+        double weight = 0.0;
+        double error  = 0.0;
+        double hits   = 0.0; // 进入槽位以来的样本数，随权重一起衰减
+
+        [[nodiscard]] double mean() const { return hits > 0.0 ? (weight - error) / hits : 0.0; }
+    };
+
+    explicit HeavyHitters(size_t capacity = 64) { resize(capacity); }
+
+    // 清空并改变容量
+    void resize(size_t capacity) {
+        mCapacity = std::max<size_t>(capacity, 1);
+        mEntries.clear();
+        mEntries.reserve(mCapacity);
+        mIndex.clear();
+        mIndex.reserve(mCapacity);
+        mTotal = 0.0;
+    }
+
+    void add(Key const& key, double weight, double hits = 1.0) {
+        mTotal += weight;
+        if (auto found = mIndex.find(key); found != mIndex.end()) {
+            auto& e   = mEntries[found->second];
+            e.weight += weight;
+            e.hits   += hits;
+            return;
+        }
+        if (mEntries.size() < mCapacity) {
+            mIndex.emplace(key, mEntries.size());
+            mEntries.push_back({key, weight, 0.0, hits});
+            return;
+        }
+        auto   victim = std::min_element(mEntries.begin(), mEntries.end(), [](Entry const& a, Entry const& b) {
+            return a.weight < b.weight;
+        });
+        size_t slot   = static_cast<size_t>(victim - mEntries.begin());
+        mIndex.erase(victim->key);
+        mIndex.emplace(key, slot);
+        *victim = {key, victim->weight + weight, victim->weight, hits};
+    }
+
+    // 所有权重按 factor 衰减，使旧样本逐渐淡出
+    void decay(double factor) {
+        mTotal *= factor;
+        for (auto& e : mEntries) {
+            e.weight *= factor;
+            e.error  *= factor;
+            e.hits   *= factor;
+        }
+    }
+
+    // 按权重降序取前 n 个
+    [[nodiscard]] std::vector<Entry> top(size_t n) const {
+        return topBy(n, [](Entry const& a, Entry const& b) { return a.weight > b.weight; });
+    }
+
+    // 按平均权重降序取前 n 个，忽略样本数不足 minHits 的槽位
+    [[nodiscard]] std::vector<Entry> topByMean(size_t n, double minHits) const {
+        auto out = topBy(mEntries.size(), [](Entry const& a, Entry const& b) { return a.mean() > b.mean(); });
+        std::erase_if(out, [minHits](Entry const& e) { return e.hits < minHits; });
+        if (out.size() > n) out.resize(n);
+        return out;
+    }
+
+    [[nodiscard]] double total() const { return mTotal; }
+    [[nodiscard]] size_t size() const { return mEntries.size(); }
+    [[nodiscard]] size_t capacity() const { return mCapacity; }
+
+private:
+    template <class Compare>
+    std::vector<Entry> topBy(size_t n, Compare comp) const {
+        std::vector<Entry> out = mEntries;
+        n                      = std::min(n, out.size());
+        std::partial_sort(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(n), out.end(), comp);
+        out.resize(n);
+        return out;
+    }
+
+    std::vector<Entry>              mEntries;
+    std::unordered_map<Key, size_t> mIndex;
+    size_t                          mCapacity = 64;
+    double                          mTotal    = 0.0; // 全部样本（含未被跟踪的）的衰减总权重
+};
+
+} // namespace tps_item_optimizer
@@ -0,0 +1,132 @@
+#include "JournalWriter.h"
+#include <algorithm>
+#include <charconv>
+#include <system_error>
+
+namespace tps_item_optimizer {
+
+std::vector<JournalWriter::Entry> JournalWriter::start(std::filesystem::path path) {
+    stop();
+    mPath = std::move(path);
+    mLive.clear();
+    mTombstones = 0;
+
+    // 墓碑、无法解析的行与写了一半的末行都计入墓碑数，后台线程开始时先压缩掉
+    std::ifstream in(mPath);
+    std::string   line;
+    while (std::getline(in, line)) {
+        if (in.eof()) {
+            ++mTombstones;
+            break;
+        }
+        std::uint64_t id   = 0;
+        char const*   last = line.data() + line.size();
+        auto [ptr, ec]     = std::from_chars(line.data() + std::min<size_t>(line.size(), 1), last, id);
+        if (ec == std::errc{} && line[0] == '+' && ptr != last && *ptr == ' ') {
+            mLive.insert_or_assign(id, std::string(ptr + 1, last));
+            continue;
+        }
+        if (ec == std::errc{} && line[0] == '-' && ptr == last) mLive.erase(id);
+        ++mTombstones;
+    }
+    in.close();
+
+    std::vector<Entry> out(mLive.begin(), mLive.end());
+    mThread = std::jthread([this](std::stop_token st) {
+        std::error_code ec;
+        std::filesystem::create_directories(mPath.parent_path(), ec);
+        if (mTombstones == 0) mFile.open(mPath, std::ios::app);
+        else if (!compact()) mFile << '\n'; // 末行可能写了一半，另起一行再追加
+
+        std::unique_lock lock(mMutex);
+        while (true) {
+            // 请求停止后仍把队列写完再退出
+            mCv.wait(lock, st, [this] { return !mQueue.empty(); });
+            if (mQueue.empty()) break;
+            auto jobs = std::move(mQueue);
+            mQueue.clear();
+            lock.unlock();
+            for (auto& job : jobs) {
+                bool ok = write(job);
+                if (!ok) mFailed.fetch_add(1, std::memory_order_relaxed);
+                if (job.done) job.done->set_value(ok);
+            }
+            if (mTombstones > std::max<size_t>(1024, mLive.size())) compact();
+            lock.lock();
+        }
+        mFile.close();
+    });
+    return out;
+}
+
+void JournalWriter::stop() {
+    if (!mThread.joinable()) return;
+    mThread.request_stop();
+    mThread.join();
+}
+
+bool JournalWriter::add(std::vector<Entry> entries) {
+    if (entries.empty()) return true;
+    if (!mThread.joinable()) return false;
+    std::promise<bool> done;
+    auto               result = done.get_future();
+    {
+        std::lock_guard lock(mMutex);
+        mQueue.push_back({std::move(entries), {}, &done});
+    }
+    mCv.notify_one();
+    return result.get();
+}
+
+void JournalWriter::remove(std::vector<std::uint64_t> ids) {
+    if (ids.empty() || !mThread.joinable()) return;
+    {
+        std::lock_guard lock(mMutex);
+        mQueue.push_back({{}, std::move(ids), nullptr});
+    }
+    mCv.notify_one();
+}
+
+bool JournalWriter::write(Job& job) {
+    for (auto& [id, text] : job.added) mFile << '+' << id << ' ' << text << '\n';
+    for (auto id : job.removed) mFile << '-' << id << '\n';
+    mFile.flush();
+    bool ok = mFile.good();
+    if (!ok) {
+        // 新增失败时尽量补上墓碑，免得写进去的半截记录在载入时与仍在世界中的实体重复
+        mFile.clear();
+        mFile << '\n';
+        for (auto& [id, text] : job.added) mFile << '-' << id << '\n';
+        mFile.flush();
+        mFile.clear();
+        for (auto& [id, text] : job.added) mLive.erase(id);
+        return false;
+    }
+    for (auto& [id, text] : job.added) mLive.insert_or_assign(id, std::move(text));
+    for (auto id : job.removed) {
+        mLive.erase(id);
+        ++mTombstones;
+    }
+    return true;
+}
+
+// 先写临时文件再替换；失败时继续追加到原文件
+bool JournalWriter::compact() {
+    mFile.close();
+    auto temp = std::filesystem::path{mPath}.replace_extension(".tmp");
+    bool ok   = false;
+    {
+        std::ofstream out(temp, std::ios::trunc);
+        for (auto const& [id, text] : mLive) out << '+' << id << ' ' << text << '\n';
+        out.flush();
+        ok = out.good();
+    }
+    std::error_code ec;
+    if (ok) std::filesystem::rename(temp, mPath, ec);
+    ok = ok && !ec;
+    if (ok) mTombstones = 0;
+    mFile.open(mPath, std::ios::app);
+    return ok;
+}
+
+} // namespace tps_item_optimizer
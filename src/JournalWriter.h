@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace tps_item_optimizer {
+
+// 只追加的记录文件：每行一条，"+id 内容" 新增一条记录，"-id" 是删除它的墓碑。
+// 文件只在后台线程上写入；墓碑多于存活记录时在该线程上压缩重写，服务器线程不做整体重写。
+// 内容不能含换行；崩溃时写了一半的末行在载入时丢弃
+class JournalWriter {
+public:
+    using Entry = std::pair<std::uint64_t, std::string>;
+
+    ~JournalWriter() { stop(); }
+
+    // 载入文件中存活的记录并开始后台写入；已在运行时先停止
+    std::vector<Entry> start(std::filesystem::path path);
+
+    // 写完已排队的内容后停止
+    void stop();
+
+    // 新增记录，等待写入完成，返回是否成功；失败的记录不会在载入时出现
+    bool add(std::vector<Entry> entries);
+
+    // 写墓碑，不等待；写入失败时记录会在下次载入时重新出现
+    void remove(std::vector<std::uint64_t> ids);
+
+    [[nodiscard]] size_t failedWrites() const { return mFailed.load(std::memory_order_relaxed); }
+
+private:
+    struct Job {
+        std::vector<Entry>         added;
+        std::vector<std::uint64_t> removed;
+        std::promise<bool>*        done = nullptr;
+    };
+
+    bool write(Job& job);
+    bool compact();
+
+    std::filesystem::path mPath;
+    std::ofstream         mFile;
+
+    // 仅后台线程访问：存活记录的副本供压缩用，以及上次压缩后写入的墓碑数
+    std::map<std::uint64_t, std::string> mLive;
+    size_t                               mTombstones = 0;
+
+    std::mutex                  mMutex;
+    std::condition_variable_any mCv;
+    std::deque<Job>             mQueue;
+    std::atomic<size_t>         mFailed = 0;
+    std::jthread                mThread;
+};
+
+} // namespace tps_item_optimizer
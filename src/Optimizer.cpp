@@ -1,28 +1,119 @@
 #include "Optimizer.h"
+#include "Census.h"
+#include "ChunkKey.h"
+#include "Controller.h"
+#include "DropLimiter.h"
+#include "FileWatcher.h"
+#include "FlowField.h"
+#include "HeavyHitters.h"
+#include "Rules.h"
+#include "Stats.h"
+#include "SuperStacks.h"
+#include "VirtualItems.h"
 #include <ll/api/memory/Hook.h>
 #include <ll/api/mod/RegisterHelper.h>
 #include <ll/api/io/Logger.h>
 #include <ll/api/io/LoggerRegistry.h>
 #include <ll/api/coro/CoroTask.h>
 #include <ll/api/thread/ServerThreadExecutor.h>
+#include <ll/api/event/EventBus.h>
+#include <ll/api/event/player/PlayerPickUpItemEvent.h>
+#include <ll/api/reflection/Deserialization.h>
+#include <ll/api/service/Bedrock.h>
+#include <nlohmann/json.hpp>
 #include <mc/world/actor/Actor.h>
 #include <mc/world/actor/ActorCategory.h>
+#include <mc/world/actor/item/ItemActor.h>
+#include <mc/world/actor/player/Player.h>
+#include <mc/world/item/ItemStack.h>
 #include <mc/world/level/Level.h>
+#include <mc/world/level/BlockPos.h>
 #include <mc/world/level/BlockSource.h>
+#include <mc/world/level/block/Block.h>
+#include <mc/world/level/block/actor/Hopper.h>
 #include <mc/world/level/Tick.h>
 #include <mc/legacy/ActorUniqueID.h>
 #include <filesystem>
+#include <format>
+#include <fstream>
 #include <chrono>
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <unordered_set>
+#include <utility>
 
 namespace tps_item_optimizer {
 
 // 全局
 static Config config;
 static std::shared_ptr<ll::io::Logger> log;
-static bool debugTaskRunning = false;
+// 后台循环任务。stop 后紧接着 start 时，旧循环醒来发现代数已变即退出，不会同时跑两个循环
+struct TaskLoop {
+    bool          running    = false;
+    std::uint64_t generation = 0;
 
-static std::unordered_map<ActorUniqueID, std::uint64_t> lastItemTick;
+    std::uint64_t start() {
+        running = true;
+        return ++generation;
+    }
+    void stop() {
+        running = false;
+        ++generation;
+    }
+    [[nodiscard]] bool current(std::uint64_t gen) const { return running && gen == generation; }
+};
+
+static TaskLoop debugTask;
+static TaskLoop snapshotTask;
+static TaskLoop experimentTask;
+
+// 每个掉落物的跟踪状态
+struct ItemState {
+    std::uint64_t lastTick    = 0;     // 上次放行的 tick，尚未放行时为首次出现的 tick
+    std::uint64_t firstTick   = 0;     // 首次出现的 tick
+    std::uint64_t seenTick    = 0;     // 上次经过 tick hook 的 tick（含被限流），过期清理按它判断
+    std::uint8_t  cohort      = 0;     // A/B 实验分组
+    bool          admitted    = false; // 放行过；一直被限流的掉落物也有条目
+    bool          liquidAdmit = false; // 上次放行时在液体中，本次才从 posDelta 学习流速
+
+    std::uint64_t chunk            = 0; // 首次出现或上次放行时所在区块
+    std::uint32_t admittedInWindow = 0; // 公平性窗口内的放行次数
+
+    // 规则特征，每次准入检查前刷新
+    std::uint8_t typeClass  = 0;
+    ItemMotion   motion     = ItemMotion::Resting;
+    float        playerDist = std::numeric_limits<float>::infinity();
+
+    // 进入拾取/漏斗范围的 tick，0 表示不在范围内；每 sloProbeInterval 次准入检查探测一次
+    std::uint64_t pickupRangeTick = 0;
+    std::uint64_t hopperRangeTick = 0;
+    std::uint16_t sloProbeSkip    = 0; // 距下次探测还要跳过的准入检查次数
+    std::uint64_t pickupReadyTick = 0; // 原版拾取冷却结束的 tick，之前在范围内也拾取不了
+
+    SpawnSource source; // 生成来源
+
+    std::uint64_t restingSince = 0; // 普查首次观察到静止的 tick，0 表示在动
+};
+
+// 距 tick 经过的 tick 数；同一 tick 内插入后再次读取时为 0
+static std::uint64_t ticksSince(std::uint64_t now, std::uint64_t tick) { return now > tick ? now - tick : 0; }
+
+static std::unordered_map<ActorUniqueID, ItemState> trackedItems;
+static std::vector<ActorUniqueID>                   deferredItems; // 本 tick 被限流、等待余量收割
+
+// 按区块批量 tick
+struct BatchEntry {
+    int           dim;
+    std::uint64_t morton; // 子区块坐标的 Morton 序
+    ActorUniqueID id;
+};
+
+static std::vector<BatchEntry> batchItems;
+static RunningStat             directItemUs;           // 采样的直接 tick 单次耗时
+static RunningStat             batchedItemUs;          // 每批的平均单次耗时
+static size_t                  totalBatchVanished = 0; // 入队后、执行前已被移除的
 static int           processedThisTick = 0;
 static std::uint64_t lastTickId        = 0;
 static int           cleanupCounter    = 0;
@@ -31,12 +122,152 @@ static int           cleanupCounter    = 0;
 static int dynMaxPerTick    = 20;
 static int dynCooldownTicks = 2;
 
+// 控制器
+static std::unique_ptr<Controller>          controller;
+static ControlState                         controlState;
+static std::unique_ptr<OscillationDetector> oscillation;
+static std::unique_ptr<WorldSpikeFilter>    spikeFilter;
+static double                               itemCostMs        = 0.0;
+static std::uint64_t                        costSampleCounter = 0;
+static int                                  spawnedThisTick   = 0; // 生成 hook 计数
+static int                                  removedThisTick   = 0;
+static double                               spawnRate         = 0.0;
+static double                               growthRate        = 0.0; // 掉落物数量每 tick 的净增长
+static double                               itemMsThisTick    = 0.0;
+static int                                  warmupTicksLeft   = 0;
+static int                                  warmupStableRun   = 0;
+
+// 令牌桶
+static double tokenRefillRate = 20.0;
+static double tokenBalance    = 0.0;
+
+// A/B 实验
+constexpr std::uint8_t CohortControl   = 0;
+constexpr std::uint8_t CohortTreatment = 1;
+
+struct CohortStats {
+    RunningStat costUs;        // 采样的单次 tick 耗时
+    RunningStat staleness;     // 放行时距上次放行的 tick 数
+    RunningStat pickupLatency; // 从进入拾取范围到被拾取的 tick 数，与 SLO 口径一致
+    RunningStat spawnToPickup; // 从首次出现到被拾取的 tick 数，含被限流推迟的运动
+};
+
+static CohortStats            cohortStats[2];
+static ll::event::ListenerPtr pickupListener;
+
+// 延迟 SLO
+static TickHistogram pickupLatencyHist;
+static TickHistogram hopperLatencyHist;
+static int           sloWindowElapsed  = 0;
+static bool          pickupSloViolated = false;
+static bool          hopperSloViolated = false;
+
+// 原版拾取冷却：方块等掉落 10 tick，玩家丢出 40 tick
+constexpr std::uint64_t PickupDelayTicks       = 10;
+constexpr std::uint64_t PlayerPickupDelayTicks = 40;
+
+static std::unordered_set<ActorUniqueID> playerDrops;             // 玩家丢出、尚未首次检查的掉落物
+static Actor const*                      hopperPulling = nullptr; // 正被漏斗吸入的掉落物
+
+static std::uint8_t cohortOf(ActorUniqueID const& id) {
+    // splitmix64，保证分组与 ID 分配规律无关
+    auto x = static_cast<std::uint64_t>(id.rawID) + 0x9E3779B97F4A7C15ull;
+    x      = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x      = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    x      = x ^ (x >> 31);
+    return static_cast<int>(x % 100) < config.experimentTreatmentPercent ? CohortTreatment : CohortControl;
+}
+
+// 规则
+static RuleTable rules;
+
+// 公平性
+struct FairnessResult {
+    size_t items     = 0;
+    size_t chunks    = 0;
+    double itemJain  = 1.0;
+    double itemGini  = 0.0;
+    double chunkJain = 1.0;
+    double chunkGini = 0.0;
+    // 区块键 -> 平均每个掉落物的放行次数，升序
+    std::vector<std::pair<std::uint64_t, double>> worstChunks;
+};
+
+static FairnessResult fairness;
+static int            fairnessWindowElapsed = 0;
+
+// 窗口内移出跟踪的掉落物：(区块, 放行次数)，窗口折叠时一并计入
+static std::vector<std::pair<std::uint64_t, std::uint32_t>> fairnessRetired;
+
+static void retireFromFairness(ItemState const& state) {
+    fairnessRetired.emplace_back(state.chunk, state.admittedInWindow);
+}
+
+// 刷物机检测与隔离
+struct ChunkWindow {
+    std::uint32_t spawns  = 0;   // 生成 hook 统计的真实生成数
+    double        costMs  = 0.0; // 采样放大后的掉落物耗时
+    int           strikes = 0;   // 连续超标的窗口数
+};
+
+struct Quarantine {
+    std::uint64_t              untilTick = 0;
+    std::vector<ActorUniqueID> anchors; // 积极合并的目标
+};
+
+static std::unordered_map<std::uint64_t, ChunkWindow> chunkWindows;
+static std::unordered_map<std::uint64_t, Quarantine>  quarantined;
+static int                                            lagWindowElapsed = 0;
+static double                                         lagWindowTickMs  = 0.0;
+static size_t                                         quarantineMerged = 0;
+
+// 掉落物普查：按哈希桶下标分段遍历 trackedItems，桶数变化（rehash）时从头开始
+static CensusBuilder census;
+static size_t        censusBucket      = 0;
+static size_t        censusBucketCount = 0; // 0 表示空闲
+static std::uint64_t censusNextTick    = 0;
+
+// 超级堆叠：每轮普查中各区块、各物品类型的并入目标
+struct StackAnchor {
+    ActorUniqueID id;
+    Vec3          pos;
+    std::string   type;
+};
+
+static std::unordered_map<std::uint64_t, std::vector<StackAnchor>> stackAnchors;
+
+// 耗时画像
+static HeavyHitters<std::uint64_t> chunkCost;
+static HeavyHitters<std::string>   typeCost;
+static int                         profileElapsed = 0;
+
+// 衰减累计值换算为近期每秒耗时：稳态下 W = r / (1 - decay)
+static double profileRate(double weight) {
+    return config.profileDecay < 1.0 ? weight * (1.0 - config.profileDecay) : weight;
+}
+
+// 液体流场
+static FlowField     flowField;
+static RunningStat   liquidTickUs; // 采样的液体中原版 tick 耗时
+static RunningStat   flowStepUs;   // 采样的快速路径耗时
+static std::uint64_t flowSampleCounter = 0;
+
 // 调试统计
 static size_t totalProcessed       = 0;
 static size_t totalCooldownSkipped = 0;
 static size_t totalThrottleSkipped = 0;
+static size_t totalBurstAdmitted   = 0;
+static size_t statTicks            = 0;
+static double statTickMs           = 0.0;
+static double statItemMs           = 0.0;
+static size_t statSpikeTicks       = 0;
+static double statSpikeMs          = 0.0;
 static size_t totalDespawnCleaned  = 0;
 static size_t totalExpiredCleaned  = 0;
+static size_t totalCatchUpTicks    = 0;
+static size_t totalCatchUpBlocked  = 0;
+static size_t totalSlackTicked     = 0;
+static double statSlackMs          = 0.0;
 
 static ll::io::Logger& getLogger() {
     if (!log) {
@@ -47,58 +278,1332 @@ static ll::io::Logger& getLogger() {
 
 Config& getConfig() { return config; }
 
+static std::filesystem::path configPath() {
+    return Optimizer::getInstance().getSelf().getConfigDir() / "config.json";
+}
+
+// 非法值回退为默认值，不访问任何全局状态，可在后台线程调用
+static void validateConfig(Config& cfg) {
+    if (cfg.cleanupIntervalTicks < 1)  cfg.cleanupIntervalTicks = 100;
+    if (cfg.maxExpiredAge        < 1)  cfg.maxExpiredAge        = 600;
+    if (cfg.initialMapReserve   == 0)  cfg.initialMapReserve    = 500;
+    if (cfg.maxPerTickStep       < 1)  cfg.maxPerTickStep       = 1;
+    if (cfg.cooldownTicksStep    < 1)  cfg.cooldownTicksStep    = 1;
+    if (cfg.targetTickMs         < 1)  cfg.targetTickMs         = 50;
+    if (cfg.costSampleInterval   < 1)  cfg.costSampleInterval   = 16;
+    if (cfg.aimdDecrease <= 0.0 || cfg.aimdDecrease >= 1.0) cfg.aimdDecrease = 0.5;
+    if (cfg.mpcSmoothing <= 0.0 || cfg.mpcSmoothing >  1.0) cfg.mpcSmoothing = 0.3;
+    if (cfg.feedforwardCountGain < 0.0) cfg.feedforwardCountGain = 0.0;
+    if (cfg.feedforwardSpawnGain < 0.0) cfg.feedforwardSpawnGain = 0.0;
+    if (cfg.oscillationWindow    < 4)  cfg.oscillationWindow    = 40;
+    if (cfg.oscillationCalmTicks < 1)  cfg.oscillationCalmTicks = 200;
+    if (cfg.targetItemTickMs     < 1)  cfg.targetItemTickMs     = 20;
+    if (cfg.controlTarget != "total" && cfg.controlTarget != "item") cfg.controlTarget = "total";
+    if (cfg.worldSpikeFactor    <= 1.0) cfg.worldSpikeFactor = 2.0;
+    if (cfg.worldSpikeMinMs     <  0.0) cfg.worldSpikeMinMs  = 15.0;
+    if (cfg.worldSpikeMaxRun    <  1)   cfg.worldSpikeMaxRun = 100;
+    if (cfg.warmupSeconds        < 0)  cfg.warmupSeconds        = 0;
+    if (cfg.warmupStableTicks    < 1)  cfg.warmupStableTicks    = 100;
+    if (cfg.tokenBurst           < 0)  cfg.tokenBurst           = 0;
+    if (cfg.snapshotIntervalSeconds < 0) cfg.snapshotIntervalSeconds = 0;
+    cfg.experimentTreatmentPercent = std::clamp(cfg.experimentTreatmentPercent, 0, 100);
+    if (cfg.experimentControlCooldownScale   <= 0.0) cfg.experimentControlCooldownScale   = 1.0;
+    if (cfg.experimentTreatmentCooldownScale <= 0.0) cfg.experimentTreatmentCooldownScale = 1.0;
+    if (cfg.experimentReportSeconds < 1) cfg.experimentReportSeconds = 60;
+    if (cfg.pickupRange   <= 0.0) cfg.pickupRange    = 2.0;
+    cfg.sloProbeInterval = std::clamp(cfg.sloProbeInterval, 1, 1024);
+    if (cfg.sloWindowTicks < 20)  cfg.sloWindowTicks = 1200;
+    if (cfg.sloPickupTicks < 1)   cfg.sloPickupTicks = 10;
+    if (cfg.sloHopperTicks < 1)   cfg.sloHopperTicks = 20;
+    cfg.sloPickupTicks = std::min(cfg.sloPickupTicks, 250);
+    cfg.sloHopperTicks = std::min(cfg.sloHopperTicks, 250);
+    if (cfg.fairnessWindowTicks < 20) cfg.fairnessWindowTicks = 1200;
+    if (cfg.fairnessWorstChunks < 0)  cfg.fairnessWorstChunks = 5;
+    if (cfg.dropLimitPlayerPerSecond <= 0.0) cfg.dropLimitPlayerPerSecond = 20.0;
+    if (cfg.dropLimitBlockPerSecond  <= 0.0) cfg.dropLimitBlockPerSecond  = 8.0;
+    if (cfg.dropLimitChunkPerSecond  <= 0.0) cfg.dropLimitChunkPerSecond  = 100.0;
+    if (cfg.dropLimitPlayerBurst < 1) cfg.dropLimitPlayerBurst = 64;
+    if (cfg.dropLimitBlockBurst  < 1) cfg.dropLimitBlockBurst  = 32;
+    if (cfg.dropLimitChunkBurst  < 1) cfg.dropLimitChunkBurst  = 200;
+    if (cfg.dropMergeRadius <= 0.0) cfg.dropMergeRadius = 8.0;
+    if (cfg.lagWindowTicks < 20)         cfg.lagWindowTicks          = 200;
+    if (cfg.lagStrikes     < 1)          cfg.lagStrikes              = 3;
+    if (cfg.quarantineSeconds < 1)       cfg.quarantineSeconds       = 300;
+    if (cfg.quarantineCooldownTicks < 1) cfg.quarantineCooldownTicks = 100;
+    if (cfg.quarantineMergeRadius <= 0.0) cfg.quarantineMergeRadius = 4.0;
+    if (cfg.censusItemsPerTick    < 0) cfg.censusItemsPerTick    = 0;
+    if (cfg.censusIntervalSeconds < 1) cfg.censusIntervalSeconds = 10;
+    if (cfg.configReloadSeconds   < 0) cfg.configReloadSeconds   = 0;
+    if (cfg.chunkProfileSize      < 0) cfg.chunkProfileSize      = 0;
+    if (cfg.typeProfileSize       < 0) cfg.typeProfileSize       = 0;
+    if (cfg.flowCellTicks         < 1) cfg.flowCellTicks         = 200;
+    if (cfg.virtualizeDistance <= 0.0) cfg.virtualizeDistance = 96.0;
+    if (cfg.virtualizeGuard < 0.0 || cfg.virtualizeGuard >= cfg.virtualizeDistance) {
+        cfg.virtualizeGuard = cfg.virtualizeDistance / 6.0;
+    }
+    if (cfg.virtualizeAfterSeconds < 1) cfg.virtualizeAfterSeconds = 60;
+    if (cfg.rematerializePerTick   < 1) cfg.rematerializePerTick   = 32;
+    if (cfg.superStackRadius <= 0.0) cfg.superStackRadius = 2.0;
+    if (cfg.catchUpMaxTicks < 0) cfg.catchUpMaxTicks = 0;
+    if (cfg.slackMarginMs   < 0.0) cfg.slackMarginMs = 0.0;
+    if (cfg.superStackLimit  < 64)   cfg.superStackLimit  = 4096;
+    if (cfg.profileDecay <= 0.0 || cfg.profileDecay > 1.0) cfg.profileDecay = 0.95;
+    cfg.warmupDamping = std::clamp(cfg.warmupDamping, 0.0, 1.0);
+}
+
 bool loadConfig() {
-    auto path   = Optimizer::getInstance().getSelf().getConfigDir() / "config.json";
-    bool loaded = ll::config::loadConfig(config, path);
-    if (config.cleanupIntervalTicks < 1)  config.cleanupIntervalTicks = 100;
-    if (config.maxExpiredAge        < 1)  config.maxExpiredAge        = 600;
-    if (config.initialMapReserve   == 0)  config.initialMapReserve    = 500;
-    if (config.maxPerTickStep       < 1)  config.maxPerTickStep       = 1;
-    if (config.cooldownTicksStep    < 1)  config.cooldownTicksStep    = 1;
-    if (config.targetTickMs         < 1)  config.targetTickMs         = 50;
+    bool loaded = ll::config::loadConfig(config, configPath());
+    validateConfig(config);
     return loaded;
 }
 
 bool saveConfig() {
-    auto path = Optimizer::getInstance().getSelf().getConfigDir() / "config.json";
-    return ll::config::saveConfig(config, path);
+    return ll::config::saveConfig(config, configPath());
+}
+
+static std::filesystem::path snapshotPath() {
+    return Optimizer::getInstance().getSelf().getDataDir() / "controller.json";
+}
+
+static bool loadSnapshot() {
+    ControllerSnapshot snap;
+    if (!ll::config::loadConfig(snap, snapshotPath()) || !snap.valid) return false;
+    controlState.maxPerTick    = snap.maxPerTick;
+    controlState.cooldownTicks = snap.cooldownTicks;
+    itemCostMs                 = snap.itemCostMs;
+    spawnRate                  = snap.spawnRate;
+    if (spikeFilter) spikeFilter->restore(snap.spikeBaselineMs);
+    if (oscillation) oscillation->restore(snap.gainScale, snap.deadbandMs);
+    if (controller && snap.controller == controller->name()) controller->importModel(snap.model);
+    return true;
+}
+
+static bool saveSnapshot() {
+    ControllerSnapshot snap;
+    snap.valid         = true;
+    snap.maxPerTick    = controlState.maxPerTick;
+    snap.cooldownTicks = controlState.cooldownTicks;
+    snap.itemCostMs    = itemCostMs;
+    snap.spawnRate     = spawnRate;
+    if (spikeFilter) snap.spikeBaselineMs = spikeFilter->baselineMs();
+    if (oscillation) {
+        snap.gainScale  = oscillation->gainScale();
+        snap.deadbandMs = oscillation->deadbandMs();
+    }
+    if (controller) {
+        snap.controller = controller->name();
+        snap.model      = controller->exportModel();
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(snapshotPath().parent_path(), ec);
+    return ll::config::saveConfig(snap, snapshotPath());
 }
 
 static void resetStats() {
-    totalProcessed = totalCooldownSkipped = totalThrottleSkipped = 0;
+    totalProcessed = totalCooldownSkipped = totalThrottleSkipped = totalBurstAdmitted = 0;
     totalDespawnCleaned = totalExpiredCleaned = 0;
+    totalCatchUpTicks = totalCatchUpBlocked = totalSlackTicked = 0;
+    statSlackMs = 0.0;
+    statTicks  = 0;
+    statTickMs = statItemMs = 0.0;
+    statSpikeTicks = 0;
+    statSpikeMs    = 0.0;
 }
 
 static void startDebugTask() {
-    if (debugTaskRunning) return;
-    debugTaskRunning = true;
+    if (debugTask.running) return;
+    auto gen = debugTask.start();
 
-    ll::coro::keepThis([]() -> ll::coro::CoroTask<> {
-        while (debugTaskRunning) {
+    ll::coro::keepThis([gen]() -> ll::coro::CoroTask<> {
+        while (debugTask.current(gen)) {
             co_await std::chrono::seconds(5);
-            ll::thread::ServerThreadExecutor::getDefault().execute([] {
-                if (!config.debug) return;
+            ll::thread::ServerThreadExecutor::getDefault().execute([gen] {
+                if (!debugTask.current(gen) || !config.debug) return;
                 size_t total = totalProcessed + totalCooldownSkipped + totalThrottleSkipped;
                 double skipRate = total > 0
                     ? (100.0 * (totalCooldownSkipped + totalThrottleSkipped) / total)
                     : 0.0;
+                double avgTickMs = statTicks > 0 ? statTickMs / statTicks : 0.0;
+                double avgItemMs = statTicks > 0 ? statItemMs / statTicks : 0.0;
                 getLogger().info(
-                    "Item stats (5s): dynMaxPerTick={}, dynCooldown={} | "
+                    "Tick time (5s avg): mspt={:.2f}ms, itemMs={:.2f}ms, itemShare={:.1f}%, target={} | "
+                    "worldSpikes={} ({:.0f}ms excluded), baseline={:.2f}ms | slackTicked={} ({:.2f}ms included)",
+                    avgTickMs, avgItemMs,
+                    avgTickMs > 0.0 ? 100.0 * avgItemMs / avgTickMs : 0.0,
+                    config.controlTarget,
+                    statSpikeTicks, statSpikeMs,
+                    spikeFilter ? spikeFilter->baselineMs() : 0.0,
+                    totalSlackTicked, statSlackMs
+                );
+                getLogger().info(
+                    "Item stats (5s): controller={}, dynMaxPerTick={}, dynCooldown={}, "
+                    "itemCost={:.3f}ms, spawnRate={:.2f} | "
                     "processed={}, cooldownSkip={}, throttleSkip={}, "
-                    "skipRate={:.1f}%, despawnClean={}, expiredClean={}, tracked={}",
-                    dynMaxPerTick, dynCooldownTicks,
+                    "skipRate={:.1f}%, despawnClean={}, expiredClean={}, tracked={}, "
+                    "tokens={:.1f}, burstAdmit={}, catchUpTicks={}, catchUpBlocked={}",
+                    controller ? controller->name() : "none", dynMaxPerTick, dynCooldownTicks, itemCostMs, spawnRate,
                     totalProcessed, totalCooldownSkipped, totalThrottleSkipped,
                     skipRate, totalDespawnCleaned, totalExpiredCleaned,
-                    lastItemTick.size()
+                    trackedItems.size(), tokenBalance, totalBurstAdmitted, totalCatchUpTicks, totalCatchUpBlocked
                 );
+                getLogger().info("{}", fairnessReport());
+                if (config.dropLimit) getLogger().info("{}", dropLimiterReport());
+                if (config.chunkProfileSize > 0) {
+                    std::string hot;
+                    for (auto const& e : chunkCost.top(3)) {
+                        hot += std::format(
+                            " [{}]({}, {})={:.2f}ms/s",
+                            chunkKeyDim(e.key), chunkKeyX(e.key), chunkKeyZ(e.key), profileRate(e.weight)
+                        );
+                    }
+                    getLogger().info("Hot chunks:{}", hot.empty() ? " none" : hot);
+                }
+                if (config.flowFastPath) getLogger().info("{}", flowReport());
+                if (config.chunkBatching) getLogger().info("{}", batchReport());
+                if (config.virtualize || hasVirtualItems()) getLogger().info("{}", virtualItemsReport());
+                if (config.superStacks) getLogger().info("{}", superStackReport());
+                if (config.lagDetection) {
+                    getLogger().info("Quarantine: chunks={}, merged={}", quarantined.size(), quarantineMerged);
+                    quarantineMerged = 0;
+                }
                 resetStats();
             });
         }
-        debugTaskRunning = false;
     }).launch(ll::thread::ServerThreadExecutor::getDefault());
 }
 
-static void stopDebugTask() { debugTaskRunning = false; }
+static void stopDebugTask() { debugTask.stop(); }
+
+static void startSnapshotTask() {
+    if (snapshotTask.running || config.snapshotIntervalSeconds <= 0) return;
+    auto gen = snapshotTask.start();
+
+    ll::coro::keepThis([gen]() -> ll::coro::CoroTask<> {
+        while (snapshotTask.current(gen)) {
+            co_await std::chrono::seconds(config.snapshotIntervalSeconds);
+            ll::thread::ServerThreadExecutor::getDefault().execute([gen] {
+                if (!snapshotTask.current(gen) || !controller) return;
+                if (!saveSnapshot()) getLogger().warn("Failed to save controller snapshot");
+            });
+        }
+    }).launch(ll::thread::ServerThreadExecutor::getDefault());
+}
+
+static void stopSnapshotTask() { snapshotTask.stop(); }
+
+static float nearestPlayerDistSqr(Actor& item, Vec3 const& pos) {
+    float nearest = std::numeric_limits<float>::infinity();
+    auto  dim     = item.getDimensionId();
+    item.getLevel().forEachPlayer([&](Player& player) {
+        if (player.getDimensionId() == dim) nearest = std::min(nearest, player.getPosition().distanceToSqr(pos));
+        return true;
+    });
+    return nearest;
+}
+
+static ItemMotion classifyMotion(Actor& item) {
+    if (item.isInWater() || item.isInLava()) return ItemMotion::Liquid;
+    if (item.getPosDelta().lengthSqr() > 1.0e-4f) return ItemMotion::Moving;
+    return ItemMotion::Resting;
+}
+
+// 准入判断前刷新所在区块、规则特征，以及是否已进入玩家拾取范围或漏斗吸取范围
+static void updateItemFeatures(Actor& item, BlockSource& region, ItemState& state, std::uint64_t currentTick) {
+    Vec3 const& pos = item.getPosition();
+    state.chunk     = chunkKeyAt(item.getDimensionId().id, pos.x, pos.z);
+
+    // 范围检查要遍历玩家并读方块，按放行次数限频；首次放行必查
+    bool probe = false;
+    if (config.sloMetrics) {
+        probe = state.sloProbeSkip == 0;
+        if (probe) state.sloProbeSkip = static_cast<std::uint16_t>(config.sloProbeInterval - 1);
+        else --state.sloProbeSkip;
+    }
+    if (rules.usesDistance() || probe) {
+        float distSqr    = nearestPlayerDistSqr(item, pos);
+        state.playerDist = std::sqrt(distSqr);
+        if (probe) {
+            // 离开范围后清零，再次进入时重新计时
+            if (distSqr > config.pickupRange * config.pickupRange) state.pickupRangeTick = 0;
+            else if (state.pickupRangeTick == 0) state.pickupRangeTick = currentTick;
+        }
+    }
+    if (probe) {
+        BlockPos bp{pos};
+        bool     onHopper = false;
+        for (int dy = 0; dy <= 1 && !onHopper; ++dy) {
+            onHopper = region.getBlock(BlockPos{bp.x, bp.y - dy, bp.z}).getTypeName() == "minecraft:hopper";
+        }
+        if (!onHopper) state.hopperRangeTick = 0;
+        else if (state.hopperRangeTick == 0) state.hopperRangeTick = currentTick;
+    }
+    if (!rules.empty()) state.motion = classifyMotion(item);
+}
+
+// 编译失败时表保持为空，即忽略全部规则；只写入 table，可在后台线程调用
+static void compileRules(RuleTable& table, std::vector<std::string> const& source) {
+    std::string error;
+    if (!table.compile(source, error)) {
+        getLogger().warn("Invalid rules, ignoring all rules: {}", error);
+        return;
+    }
+    if (table.empty()) return;
+    getLogger().info(
+        "Compiled {} rules into a {}-entry decision table, evaluate={:.1f}ns/item",
+        table.ruleCount(), table.tableSize(), table.benchmarkNs(1 << 20)
+    );
+}
+
+// 范围内的掉落物在 SLO 被违反时优先放行
+static bool sloPriority(ItemState const& state) {
+    return (pickupSloViolated && state.pickupRangeTick != 0) || (hopperSloViolated && state.hopperRangeTick != 0);
+}
+
+static bool inLiquid(Actor& item) { return item.isInWater() || item.isInLava(); }
+
+// 掉落物碰撞箱：0.25 × 0.25 × 0.25，位置在底面中心
+constexpr float kItemHalfWidth = 0.125f;
+constexpr float kItemHeight    = 0.25f;
+
+static int blockCoord(float v) { return static_cast<int>(std::floor(v)); }
+
+// 原版 tick 前记录当前所在格的流速（上一次原版 tick 算出的 posDelta）；
+// 只在上次放行时已在液体中才调用，否则 posDelta 是投掷、活塞等带来的动量
+static void learnFlow(Actor& item, BlockSource& region, std::uint64_t tick) {
+    auto const& velocity = item.getPosDelta();
+    if (velocity.lengthSqr() < 1.0e-6f) return;
+    auto     pos = item.getPosition();
+    BlockPos bp{pos};
+    flowField.learn(
+        chunkKeyAt(item.getDimensionId().id, pos.x, pos.z),
+        packBlockKey(bp.x, bp.y, bp.z),
+        &region.getBlock(bp),
+        velocity,
+        tick
+    );
+}
+
+static Vec3 const* flowAt(int dim, Vec3 const& pos, BlockSource& region, std::uint64_t tick) {
+    BlockPos bp{pos};
+    return flowField.lookup(chunkKeyAt(dim, pos.x, pos.z), packBlockKey(bp.x, bp.y, bp.z), &region.getBlock(bp), tick);
+}
+
+// 碰撞箱在 pos 处覆盖的格除 from 外是否都学习过且方块未变，墙边、流场边缘的格不会被挤进去
+static bool flowBoxKnown(int dim, Vec3 const& pos, BlockPos const& from, BlockSource& region, std::uint64_t tick) {
+    for (int x = blockCoord(pos.x - kItemHalfWidth); x <= blockCoord(pos.x + kItemHalfWidth); ++x) {
+        for (int y = blockCoord(pos.y); y <= blockCoord(pos.y + kItemHeight); ++y) {
+            for (int z = blockCoord(pos.z - kItemHalfWidth); z <= blockCoord(pos.z + kItemHalfWidth); ++z) {
+                if (x == from.x && y == from.y && z == from.z) continue;
+                Vec3 cell{static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)};
+                if (!flowAt(dim, cell, region, tick)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+// 不 tick 的液体中掉落物按缓存流速平移；碰撞箱只移入同样学习过的格，流场边缘停下等原版 tick
+static bool flowStep(Actor& item, BlockSource& region, std::uint64_t tick) {
+    if (!inLiquid(item)) return false;
+    bool sample = ++flowSampleCounter % static_cast<std::uint64_t>(config.costSampleInterval) == 0;
+    auto start  = sample ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+
+    auto        pos      = item.getPosition();
+    int         dim      = item.getDimensionId().id;
+    Vec3 const* velocity = flowAt(dim, pos, region, tick);
+    if (!velocity) return false;
+    Vec3     next = pos + *velocity;
+    BlockPos from{pos};
+    if (!flowBoxKnown(dim, next, from, region, tick)) return false;
+    item.setPos(next);
+
+    if (sample) {
+        flowStepUs.add(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    return true;
+}
+
+std::string flowReport() {
+    if (!config.flowFastPath) return "Flow: disabled";
+    auto& c = flowField.counters();
+    return std::format(
+        "Flow: chunks={}, cells={}, learned={}, hits={}, misses={}, invalidatedChunks={} | "
+        "vanillaLiquidTick={:.2f}±{:.2f}us (n={}), fastPath={:.2f}±{:.2f}us (n={})",
+        flowField.chunks(), flowField.cells(), c.learned, c.hits, c.misses, c.invalidated,
+        liquidTickUs.mean, liquidTickUs.ci95(), liquidTickUs.count,
+        flowStepUs.mean, flowStepUs.ci95(), flowStepUs.count
+    );
+}
+
+static void updateSloWindow() {
+    if (++sloWindowElapsed < config.sloWindowTicks) return;
+    sloWindowElapsed = 0;
+
+    std::uint64_t pickupP95 = pickupLatencyHist.percentile(0.95);
+    std::uint64_t hopperP95 = hopperLatencyHist.percentile(0.95);
+    pickupSloViolated       = pickupP95 > static_cast<std::uint64_t>(config.sloPickupTicks);
+    hopperSloViolated       = hopperP95 > static_cast<std::uint64_t>(config.sloHopperTicks);
+
+    if (config.debug) {
+        getLogger().info(
+            "Pickup latency (n={}, p50={}, p95={}, p99={}, slo={}{})",
+            pickupLatencyHist.count, pickupLatencyHist.percentile(0.5), pickupP95,
+            pickupLatencyHist.percentile(0.99), config.sloPickupTicks, pickupSloViolated ? " VIOLATED" : ""
+        );
+        getLogger().info(
+            "Hopper latency (n={}, p50={}, p95={}, p99={}, slo={}{})",
+            hopperLatencyHist.count, hopperLatencyHist.percentile(0.5), hopperP95,
+            hopperLatencyHist.percentile(0.99), config.sloHopperTicks, hopperSloViolated ? " VIOLATED" : ""
+        );
+    }
+    pickupLatencyHist.reset();
+    hopperLatencyHist.reset();
+}
+
+static void updateFairnessWindow() {
+    if (++fairnessWindowElapsed < config.fairnessWindowTicks) return;
+    fairnessWindowElapsed = 0;
+
+    struct ChunkAcc {
+        double admitted = 0.0;
+        int    items    = 0;
+    };
+    std::vector<double>                         perItem;
+    std::unordered_map<std::uint64_t, ChunkAcc> perChunk;
+    perItem.reserve(trackedItems.size() + fairnessRetired.size());
+    auto add = [&](std::uint64_t chunk, std::uint32_t admitted) {
+        perItem.push_back(admitted);
+        auto& acc     = perChunk[chunk];
+        acc.admitted += admitted;
+        ++acc.items;
+    };
+    // 一直被限流的掉落物以 0 次计入；窗口内被移除的也不漏掉
+    for (auto& [id, state] : trackedItems) {
+        add(state.chunk, state.admittedInWindow);
+        state.admittedInWindow = 0;
+    }
+    for (auto const& [chunk, admitted] : fairnessRetired) add(chunk, admitted);
+    fairnessRetired.clear();
+
+    FairnessResult result;
+    result.items    = perItem.size();
+    result.chunks   = perChunk.size();
+    result.itemJain = jainIndex(perItem);
+    result.itemGini = giniCoefficient(perItem);
+
+    std::vector<double> chunkRates;
+    chunkRates.reserve(perChunk.size());
+    for (auto const& [key, acc] : perChunk) {
+        double rate = acc.admitted / acc.items;
+        chunkRates.push_back(rate);
+        result.worstChunks.emplace_back(key, rate);
+    }
+    result.chunkJain = jainIndex(chunkRates);
+    result.chunkGini = giniCoefficient(chunkRates);
+
+    auto worst = std::min(result.worstChunks.size(), static_cast<size_t>(config.fairnessWorstChunks));
+    std::partial_sort(
+        result.worstChunks.begin(),
+        result.worstChunks.begin() + static_cast<std::ptrdiff_t>(worst),
+        result.worstChunks.end(),
+        [](auto const& a, auto const& b) { return a.second < b.second; }
+    );
+    result.worstChunks.resize(worst);
+    fairness = std::move(result);
+}
+
+std::string fairnessReport() {
+    std::string out = std::format(
+        "Fairness ({} ticks): items={} jain={:.3f} gini={:.3f} | chunks={} jain={:.3f} gini={:.3f}",
+        config.fairnessWindowTicks,
+        fairness.items, fairness.itemJain, fairness.itemGini,
+        fairness.chunks, fairness.chunkJain, fairness.chunkGini
+    );
+    for (auto const& [key, rate] : fairness.worstChunks) {
+        out += std::format(
+            "\n  dim={} chunk=({}, {}) admitted/item={:.2f}",
+            chunkKeyDim(key), chunkKeyX(key), chunkKeyZ(key), rate
+        );
+    }
+    return out;
+}
+
+// 连续多次普查都静止、远离玩家且不在漏斗上的掉落物可以虚拟化
+static bool shouldVirtualize(ItemActor& item, ItemState& state, ItemMotion motion, std::uint64_t now) {
+    if (motion != ItemMotion::Resting) {
+        state.restingSince = 0;
+        return false;
+    }
+    if (state.restingSince == 0) {
+        state.restingSince = now;
+        return false;
+    }
+    if (now - state.restingSince < static_cast<std::uint64_t>(config.virtualizeAfterSeconds) * 20) return false;
+
+    auto pos = item.getPosition();
+    if (nearestPlayerDistSqr(item, pos) <= config.virtualizeDistance * config.virtualizeDistance) return false;
+    auto&    region = item.getDimensionBlockSource();
+    BlockPos bp{pos};
+    for (int dy = 0; dy <= 1; ++dy) {
+        if (region.getBlock(BlockPos{bp.x, bp.y - dy, bp.z}).getTypeName() == "minecraft:hopper") return false;
+    }
+    return true;
+}
+
+static StackAnchor const* findStackAnchor(std::uint64_t chunk, std::string const& type, Vec3 const& pos) {
+    auto found = stackAnchors.find(chunk);
+    if (found == stackAnchors.end()) return nullptr;
+    double radiusSqr = config.superStackRadius * config.superStackRadius;
+    for (auto const& anchor : found->second) {
+        if (anchor.type == type && anchor.pos.distanceToSqr(pos) <= radiusSqr) return &anchor;
+    }
+    return nullptr;
+}
+
+// 每 tick 推进一段普查，预算按掉落物计，最后一个桶允许略微超出
+static void updateCensus(Level& level) {
+    std::uint64_t now = level.getCurrentServerTick().tickID;
+    if (censusBucketCount == 0 && now < censusNextTick) return;
+    if (censusBucketCount != trackedItems.bucket_count()) {
+        census.begin(now);
+        censusBucket      = 0;
+        censusBucketCount = trackedItems.bucket_count();
+        stackAnchors.clear();
+    }
+
+    std::vector<ActorUniqueID>                           toVirtualize;
+    std::vector<std::pair<ActorUniqueID, ActorUniqueID>> toAbsorb; // (from, into)
+    int                                                  budget = config.censusItemsPerTick;
+    for (; budget > 0 && censusBucket < censusBucketCount; ++censusBucket) {
+        for (auto it = trackedItems.begin(censusBucket); it != trackedItems.end(censusBucket); ++it) {
+            Actor* actor = level.fetchEntity(it->first, false);
+            if (!actor || actor->isRemoved()) continue;
+            auto&         item   = static_cast<ItemActor&>(*actor);
+            auto          pos    = item.getPosition();
+            int           dim    = item.getDimensionId().id;
+            ItemMotion    motion = classifyMotion(item);
+            std::string   type   = item.item().getTypeName();
+            std::uint64_t chunk  = chunkKeyAt(dim, pos.x, pos.z);
+            census.add(type, motion, dim, now - it->second.firstTick, chunk, item.item().mCount);
+            --budget;
+
+            // 超级堆叠不虚拟化：移除实体会让余量转交给新实体
+            bool superStack = hasSuperStacks() && isSuperStack(it->first);
+            if (config.virtualize && !superStack && shouldVirtualize(item, it->second, motion, now)) {
+                toVirtualize.push_back(it->first);
+                continue;
+            }
+            if (config.superStacks && motion == ItemMotion::Resting) {
+                if (auto* anchor = findStackAnchor(chunk, type, pos)) toAbsorb.emplace_back(it->first, anchor->id);
+                else if (stackAnchors[chunk].size() < 16) stackAnchors[chunk].push_back({it->first, pos, type});
+            }
+        }
+    }
+    // 遍历结束后再移除，不破坏桶内迭代；移除不会触发 rehash
+    if (!toVirtualize.empty()) {
+        // 取出跟踪状态，移除 hook 不会把虚拟化计为拾取；记录写入失败时放回
+        std::vector<ItemActor*>                        actors;
+        std::vector<decltype(trackedItems)::node_type> nodes;
+        for (auto const& id : toVirtualize) {
+            Actor* actor = level.fetchEntity(id, false);
+            if (!actor) continue;
+            actors.push_back(static_cast<ItemActor*>(actor));
+            nodes.push_back(trackedItems.extract(id));
+        }
+        if (virtualizeItems(actors)) {
+            for (auto const& node : nodes) {
+                retireFromFairness(node.mapped());
+                if (config.dropLimit) forgetPendingSpawn(node.key());
+            }
+        } else {
+            for (auto& node : nodes) trackedItems.insert(std::move(node));
+        }
+    }
+    if (!toAbsorb.empty()) {
+        // 取出跟踪状态，移除 hook 不会把被并入的掉落物计为漏斗吸入；未并入的放回
+        std::vector<std::pair<ItemActor*, ItemActor*>> pairs;
+        std::vector<ActorUniqueID>                     fromIds;
+        std::vector<decltype(trackedItems)::node_type> nodes;
+        for (auto const& [fromId, intoId] : toAbsorb) {
+            Actor* from = level.fetchEntity(fromId, false);
+            Actor* into = level.fetchEntity(intoId, false);
+            if (!from || !into || from->isRemoved() || into->isRemoved()) continue;
+            pairs.emplace_back(static_cast<ItemActor*>(from), static_cast<ItemActor*>(into));
+            fromIds.push_back(fromId);
+            nodes.push_back(trackedItems.extract(fromId));
+        }
+        auto absorbed = absorbItems(pairs, config.superStackLimit);
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (!absorbed[i]) {
+                if (nodes[i]) trackedItems.insert(std::move(nodes[i]));
+                continue;
+            }
+            if (nodes[i]) retireFromFairness(nodes[i].mapped());
+            if (config.dropLimit) forgetPendingSpawn(fromIds[i]);
+        }
+    }
+    if (censusBucket < censusBucketCount) return;
+
+    census.publish(now);
+    censusBucketCount = 0;
+    censusNextTick    = now + static_cast<std::uint64_t>(config.censusIntervalSeconds) * 20;
+}
+
+std::string censusReport() {
+    auto snapshot = census.latest();
+    if (!snapshot) return "Census: no snapshot yet";
+    return snapshot->format(5);
+}
+
+static void updateProfiles() {
+    if (++profileElapsed < 20) return;
+    profileElapsed = 0;
+    chunkCost.decay(config.profileDecay);
+    typeCost.decay(config.profileDecay);
+}
+
+std::string chunkCostReport() {
+    if (config.chunkProfileSize == 0) return "Chunk cost: disabled";
+    double      total = chunkCost.total();
+    std::string out   = std::format(
+        "Chunk cost (top of {} slots): itemMs={:.2f}ms/s",
+        chunkCost.capacity(), profileRate(total)
+    );
+    for (auto const& e : chunkCost.top(10)) {
+        out += std::format(
+            "\n  dim={} chunk=({}, {}) {:.2f}ms/s ({:.1f}%, ±{:.2f})",
+            chunkKeyDim(e.key), chunkKeyX(e.key), chunkKeyZ(e.key),
+            profileRate(e.weight), total > 0.0 ? 100.0 * e.weight / total : 0.0, profileRate(e.error)
+        );
+    }
+    return out;
+}
+
+std::string typeCostReport() {
+    if (config.typeProfileSize == 0) return "Type cost: disabled";
+    double      total = typeCost.total();
+    std::string out   = std::format(
+        "Type cost (top of {} slots): itemMs={:.2f}ms/s\n by total:",
+        typeCost.capacity(), profileRate(total)
+    );
+    for (auto const& e : typeCost.top(8)) {
+        out += std::format(
+            "\n  {} {:.2f}ms/s ({:.1f}%, ±{:.2f}), mean={:.1f}us",
+            e.key, profileRate(e.weight), total > 0.0 ? 100.0 * e.weight / total : 0.0,
+            profileRate(e.error), e.mean() * 1000.0
+        );
+    }
+    out += "\n by mean:";
+    // 样本太少的均值不可靠，至少需要约 20 次采样
+    for (auto const& e : typeCost.topByMean(8, 20.0 * config.costSampleInterval)) {
+        out += std::format("\n  {} mean={:.1f}us, {:.2f}ms/s", e.key, e.mean() * 1000.0, profileRate(e.weight));
+    }
+    return out;
+}
+
+static std::string describeSources(Level& level, std::uint64_t chunk) {
+    std::unordered_map<std::uint64_t, int> players;
+    std::unordered_map<std::uint64_t, int> blocks;
+    int                                    unknown = 0;
+    for (auto const& [id, state] : trackedItems) {
+        if (state.chunk != chunk) continue;
+        if (state.source.player != 0) ++players[state.source.player];
+        else if (state.source.block != 0) ++blocks[state.source.block];
+        else ++unknown;
+    }
+    std::string out;
+    for (auto const& [key, n] : players) {
+        Actor* actor = level.fetchEntity(ActorUniqueID{static_cast<std::int64_t>(key)}, false);
+        if (actor && actor->isPlayer()) {
+            out += std::format("player {} x{}, ", static_cast<Player*>(actor)->getRealName(), n);
+        } else {
+            out += std::format("player #{} x{}, ", static_cast<std::int64_t>(key), n);
+        }
+    }
+    for (auto const& [key, n] : blocks) {
+        out += std::format("dispenser ({}, {}, {}) x{}, ", blockKeyX(key), blockKeyY(key), blockKeyZ(key), n);
+    }
+    out += std::format("other x{}", unknown);
+    return out;
+}
+
+// 每个窗口结束时按区块判定，连续超标的隔离，到期的解除
+static void updateLagWindow(Level& level, double tickMs) {
+    lagWindowTickMs += tickMs;
+    if (++lagWindowElapsed < config.lagWindowTicks) return;
+
+    std::uint64_t now     = level.getCurrentServerTick().tickID;
+    double        seconds = config.lagWindowTicks / 20.0;
+
+    for (auto it = quarantined.begin(); it != quarantined.end();) {
+        if (now >= it->second.untilTick) {
+            getLogger().info(
+                "Quarantine lifted: dim={} chunk=({}, {})",
+                chunkKeyDim(it->first), chunkKeyX(it->first), chunkKeyZ(it->first)
+            );
+            it = quarantined.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // 有普查快照时直接使用其区块计数，避免每个窗口全量遍历
+    std::unordered_map<std::uint64_t, int> counts;
+    if (auto snapshot = census.latest()) {
+        for (auto const& [chunk, n] : snapshot->byChunk) counts[chunk] = static_cast<int>(n);
+    } else {
+        for (auto const& [id, state] : trackedItems) ++counts[state.chunk];
+    }
+    for (auto const& [chunk, n] : counts) chunkWindows[chunk];
+
+    for (auto it = chunkWindows.begin(); it != chunkWindows.end();) {
+        auto& [chunk, win] = *it;
+        int    items       = counts.contains(chunk) ? counts[chunk] : 0;
+        double spawnRate   = win.spawns / seconds;
+        double costShare   = lagWindowTickMs > 0.0 ? win.costMs / lagWindowTickMs : 0.0;
+        bool   over        = spawnRate > config.lagSpawnPerSecond || costShare > config.lagCostShare
+                 || items > config.lagItemCount;
+        win.strikes = over ? win.strikes + 1 : 0;
+
+        if (win.strikes >= config.lagStrikes && !quarantined.contains(chunk)) {
+            quarantined[chunk].untilTick = now + static_cast<std::uint64_t>(config.quarantineSeconds) * 20;
+            getLogger().warn(
+                "Lag machine suspected, quarantining dim={} chunk=({}, {}) blocks ({}, {}): "
+                "spawnRate={:.1f}/s, costShare={:.1f}%, items={} | sources: {}",
+                chunkKeyDim(chunk), chunkKeyX(chunk), chunkKeyZ(chunk),
+                chunkKeyX(chunk) * 16, chunkKeyZ(chunk) * 16,
+                spawnRate, costShare * 100.0, items, describeSources(level, chunk)
+            );
+        }
+
+        win.spawns = 0;
+        win.costMs = 0.0;
+        if (win.strikes == 0 && items == 0) it = chunkWindows.erase(it);
+        else ++it;
+    }
+    lagWindowElapsed = 0;
+    lagWindowTickMs  = 0.0;
+}
+
+// 隔离区块内的掉落物尝试并入已有的锚点，返回 true 表示已被合并移除
+static bool quarantineMerge(Actor& item, Quarantine& q) {
+    double radiusSqr = config.quarantineMergeRadius * config.quarantineMergeRadius;
+    auto   self      = item.getOrCreateUniqueID();
+    for (auto it = q.anchors.begin(); it != q.anchors.end();) {
+        Actor* anchor = item.getLevel().fetchEntity(*it, false);
+        if (!anchor || anchor->isRemoved()) {
+            it = q.anchors.erase(it);
+            continue;
+        }
+        if (*it != self && anchor->getPosition().distanceToSqr(item.getPosition()) <= radiusSqr
+            && mergeItemActors(static_cast<ItemActor&>(item), static_cast<ItemActor&>(*anchor)))
+        {
+            ++quarantineMerged;
+            return true;
+        }
+        ++it;
+    }
+    if (q.anchors.size() < 16 && std::find(q.anchors.begin(), q.anchors.end(), self) == q.anchors.end()) {
+        q.anchors.push_back(self);
+    }
+    return false;
+}
+
+// 掉落物离开世界。只有漏斗吸入时的移除计入漏斗延迟，插件合并、过期、/kill 等都不算
+static void onItemRemoved(Actor& actor) {
+    if (config.dropLimit) forgetPendingSpawn(actor.getOrCreateUniqueID());
+    if (!playerDrops.empty()) playerDrops.erase(actor.getOrCreateUniqueID());
+    auto found = trackedItems.find(actor.getOrCreateUniqueID());
+    if (found == trackedItems.end()) return;
+    ItemState const& state = found->second;
+    if (config.sloMetrics && &actor == hopperPulling) {
+        // 两次范围检查之间进入范围的，近似按上次放行计
+        std::uint64_t since = state.hopperRangeTick != 0 ? state.hopperRangeTick : state.lastTick;
+        hopperLatencyHist.add(ticksSince(actor.getLevel().getCurrentServerTick().tickID, since));
+    }
+    retireFromFairness(state);
+    trackedItems.erase(found);
+    ++totalDespawnCleaned;
+}
+
+void countItemSpawn(ActorUniqueID const& id, std::uint64_t chunk, bool thrownByPlayer) {
+    if (!config.enabled) return;
+    ++spawnedThisTick;
+    if (config.lagDetection) ++chunkWindows[chunk].spawns;
+    if (thrownByPlayer && pickupListener) playerDrops.insert(id);
+}
+
+static void logExperiment() {
+    auto const& c = cohortStats[CohortControl];
+    auto const& t = cohortStats[CohortTreatment];
+    getLogger().info(
+        "Experiment: cooldownScale control={:.2f} treatment={:.2f} | "
+        "costUs control={:.2f}±{:.2f} (n={}) treatment={:.2f}±{:.2f} (n={}) diff={:+.2f}±{:.2f}",
+        config.experimentControlCooldownScale, config.experimentTreatmentCooldownScale,
+        c.costUs.mean, c.costUs.ci95(), c.costUs.count,
+        t.costUs.mean, t.costUs.ci95(), t.costUs.count,
+        t.costUs.mean - c.costUs.mean, diffCi95(c.costUs, t.costUs)
+    );
+    getLogger().info(
+        "Experiment: staleness control={:.2f}±{:.2f} treatment={:.2f}±{:.2f} diff={:+.2f}±{:.2f} ticks | "
+        "pickupLatency control={:.1f}±{:.1f} (n={}) treatment={:.1f}±{:.1f} (n={}) diff={:+.1f}±{:.1f} ticks",
+        c.staleness.mean, c.staleness.ci95(), t.staleness.mean, t.staleness.ci95(),
+        t.staleness.mean - c.staleness.mean, diffCi95(c.staleness, t.staleness),
+        c.pickupLatency.mean, c.pickupLatency.ci95(), c.pickupLatency.count,
+        t.pickupLatency.mean, t.pickupLatency.ci95(), t.pickupLatency.count,
+        t.pickupLatency.mean - c.pickupLatency.mean, diffCi95(c.pickupLatency, t.pickupLatency)
+    );
+    getLogger().info(
+        "Experiment: spawnToPickup control={:.1f}±{:.1f} (n={}) treatment={:.1f}±{:.1f} (n={}) "
+        "diff={:+.1f}±{:.1f} ticks",
+        c.spawnToPickup.mean, c.spawnToPickup.ci95(), c.spawnToPickup.count,
+        t.spawnToPickup.mean, t.spawnToPickup.ci95(), t.spawnToPickup.count,
+        t.spawnToPickup.mean - c.spawnToPickup.mean, diffCi95(c.spawnToPickup, t.spawnToPickup)
+    );
+}
+
+static void startExperimentTask() {
+    if (experimentTask.running || !config.experiment) return;
+    auto gen = experimentTask.start();
+
+    ll::coro::keepThis([gen]() -> ll::coro::CoroTask<> {
+        while (experimentTask.current(gen)) {
+            co_await std::chrono::seconds(config.experimentReportSeconds);
+            ll::thread::ServerThreadExecutor::getDefault().execute([gen] {
+                if (experimentTask.current(gen)) logExperiment();
+            });
+        }
+    }).launch(ll::thread::ServerThreadExecutor::getDefault());
+}
+
+static void stopExperimentTask() { experimentTask.stop(); }
+
+// 掉落物 tick 调用的上下文，origin 由 hook 传入
+struct TickCall {
+    Actor&       self;
+    BlockSource& region;
+    bool (*origin)(void* hook, BlockSource& region);
+    void*        hook;
+
+    bool run() const { return origin(hook, region); }
+};
+
+using AdmitFn = bool (*)(TickCall const&);
+
+template <bool Stats>
+static void count(size_t& counter) {
+    if constexpr (Stats) ++counter;
+}
+
+static bool admitPassthrough(TickCall const& call) { return call.run(); }
+
+static AdmitFn admitItem = &admitPassthrough;
+
+// 插件自己补 tick 期间把准入函数换成直通，掉落物 hook 不必为此再多一次判断
+struct PassthroughScope {
+    AdmitFn saved = std::exchange(admitItem, &admitPassthrough);
+    ~PassthroughScope() { admitItem = saved; }
+};
+
+// 原版掉落物的每 tick 运动：先加重力，再位移，最后乘空气阻力
+constexpr float kItemGravity = 0.04f;
+constexpr float kItemDrag    = 0.98f;
+
+// 碰撞箱在 pos 处覆盖的方块（最多 8 个）是否全为空气；非空气方块一律视为阻挡，宁可早停
+static bool itemBoxClear(BlockSource& region, Vec3 const& pos) {
+    for (int x = blockCoord(pos.x - kItemHalfWidth); x <= blockCoord(pos.x + kItemHalfWidth); ++x) {
+        for (int y = blockCoord(pos.y); y <= blockCoord(pos.y + kItemHeight); ++y) {
+            for (int z = blockCoord(pos.z - kItemHalfWidth); z <= blockCoord(pos.z + kItemHalfWidth); ++z) {
+                if (!region.getBlock(BlockPos{x, y, z}).isAir()) return false;
+            }
+        }
+    }
+    return true;
+}
+
+// 放行前补上被跳过的 ticks 个 tick 的空中运动；每步再按 0.5 格细分（小于一格，不会穿过方块），
+// 碰撞箱碰到非空气方块前停下，碰撞交给随后的原版 tick 处理
+template <bool Stats>
+static void catchUpMotion(Actor& item, BlockSource& region, std::uint64_t ticks) {
+    if (ticks == 0 || item.isOnGround() || inLiquid(item)) return;
+    auto& velocity = item.getPosDeltaNonConst();
+    if (velocity.lengthSqr() < 1.0e-6f) return;
+
+    Vec3 pos   = item.getPosition();
+    auto n     = std::min<std::uint64_t>(ticks, static_cast<std::uint64_t>(config.catchUpMaxTicks));
+    bool moved = false;
+    for (std::uint64_t t = 0; t < n; ++t) {
+        Vec3 v{velocity.x, velocity.y - kItemGravity, velocity.z};
+        int  steps = std::max(1, static_cast<int>(std::ceil(std::sqrt(v.lengthSqr()) / 0.5f)));
+        Vec3 step  = v * (1.0f / static_cast<float>(steps));
+        for (int i = 0; i < steps; ++i) {
+            Vec3 next = pos + step;
+            if (!itemBoxClear(region, next)) {
+                count<Stats>(totalCatchUpBlocked);
+                if (moved) item.setPos(pos);
+                return;
+            }
+            pos   = next;
+            moved = true;
+        }
+        velocity = v * kItemDrag;
+        count<Stats>(totalCatchUpTicks);
+    }
+    if (moved) item.setPos(pos);
+}
+
+// 首次见到时初始化，特征也在此算好。插入后仍可能被限流，lastTick 从首次出现算起，
+// 清理与陈旧度不会把它当成 tick 0 放行的
+template <bool UseRules>
+static void initItemState(TickCall const& call, ActorUniqueID const& id, ItemState& state, std::uint64_t currentTick) {
+    state.firstTick = currentTick;
+    state.lastTick  = currentTick;
+    state.cohort    = config.experiment ? cohortOf(id) : CohortControl;
+    if (config.dropLimit) takeSpawnSource(id, state.source);
+    bool thrown           = !playerDrops.empty() && playerDrops.erase(id) != 0;
+    state.pickupReadyTick = currentTick + (thrown ? PlayerPickupDelayTicks : PickupDelayTicks);
+    if constexpr (UseRules) {
+        state.typeClass = rules.typeClassOf(static_cast<ItemActor&>(call.self).item().getTypeName());
+    }
+    updateItemFeatures(call.self, call.region, state, currentTick);
+}
+
+// 限流路径上按当前位置查隔离区块
+static bool inQuarantine(Actor& item) {
+    if (quarantined.empty()) return false;
+    auto pos = item.getPosition();
+    return quarantined.contains(chunkKeyAt(item.getDimensionId().id, pos.x, pos.z));
+}
+
+// 被限流的掉落物：液体中的沿流场平移（隔离区块内的保持冻结），其余排队等待余量收割
+static void deferThrottled(TickCall const& call, ActorUniqueID const& id, std::uint64_t tick) {
+    if (config.flowFastPath && !inQuarantine(call.self) && flowStep(call.self, call.region, tick)) return;
+    if (config.slackHarvest) deferredItems.push_back(id);
+}
+
+// 准入热路径，按统计 / 规则 / 令牌桶在编译期特化。其余特性开关是运行时分支：
+// 关闭时每个掉落物每 tick 只多几次配置读取与判断，不做特性本身的工作
+template <bool Stats, bool UseRules, bool TokenBucket>
+static bool admit(TickCall const& call) {
+    std::uint64_t currentTick = call.self.getLevel().getCurrentServerTick().tickID;
+
+    if (currentTick != lastTickId) {
+        if constexpr (TokenBucket) {
+            // 按经过的 tick 数补充令牌，上限为一个 tick 的额度加突发信用
+            std::uint64_t passed = lastTickId == 0 ? 1 : currentTick - lastTickId;
+            tokenBalance         = std::min(
+                tokenBalance + tokenRefillRate * static_cast<double>(passed),
+                tokenRefillRate + config.tokenBurst
+            );
+        }
+        lastTickId        = currentTick;
+        processedThisTick = 0;
+
+        if (++cleanupCounter >= config.cleanupIntervalTicks) {
+            cleanupCounter = 0;
+            if (config.flowFastPath) flowField.prune(currentTick);
+            for (auto it = trackedItems.begin(); it != trackedItems.end();) {
+                if (ticksSince(currentTick, it->second.seenTick) >
+                    static_cast<std::uint64_t>(config.maxExpiredAge))
+                {
+                    retireFromFairness(it->second);
+                    it = trackedItems.erase(it);
+                    count<Stats>(totalExpiredCleaned);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    auto const& id = call.self.getOrCreateUniqueID();
+    // 来源超限的新掉落物合并进同来源锚点，不论是否被限流
+    if (hasPendingMerges() && mergeIfOverLimit(call.self, id)) return true;
+
+    bool throttled = TokenBucket ? tokenBalance < 1.0 : processedThisTick >= dynMaxPerTick;
+    if (throttled && !pickupSloViolated && !hopperSloViolated && !(UseRules && rules.hasPriority())) {
+        count<Stats>(totalThrottleSkipped);
+        // 被限流的也登记，公平性与普查才看得到一直被饿着的掉落物
+        auto [it, inserted] = trackedItems.try_emplace(id);
+        if (inserted) initItemState<UseRules>(call, id, it->second, currentTick);
+        it->second.seenTick = currentTick;
+        deferThrottled(call, id, currentTick);
+        return true;
+    }
+
+    auto [it, inserted] = trackedItems.try_emplace(id);
+    ItemState& state    = it->second;
+    // 规则与 SLO 优先级按本次的特征判断，一直被限流的掉落物也能靠距离规则被提上来
+    if (inserted) initItemState<UseRules>(call, id, state, currentTick);
+    else updateItemFeatures(call.self, call.region, state, currentTick);
+    state.seenTick = currentTick;
+
+    RuleAction action;
+    if constexpr (UseRules) action = rules.evaluate(state.typeClass, state.playerDist, state.motion);
+
+    bool priority = sloPriority(state) || action.kind == RuleAction::Kind::Priority;
+    if (throttled && !priority) {
+        count<Stats>(totalThrottleSkipped);
+        deferThrottled(call, id, currentTick);
+        return true;
+    }
+
+    int cooldown = dynCooldownTicks;
+    if (config.experiment) {
+        double scale = state.cohort == CohortTreatment ? config.experimentTreatmentCooldownScale
+                                                       : config.experimentControlCooldownScale;
+        cooldown     = std::max(1, static_cast<int>(std::lround(cooldown * scale)));
+    }
+    if (action.kind == RuleAction::Kind::Cooldown) cooldown = action.value;
+
+    Quarantine* quarantine = nullptr;
+    if (!quarantined.empty()) {
+        auto q = quarantined.find(state.chunk);
+        if (q != quarantined.end()) {
+            quarantine = &q->second;
+            cooldown   = std::max(cooldown, config.quarantineCooldownTicks);
+            priority   = false;
+        }
+    }
+    std::uint64_t sinceLast = ticksSince(currentTick, state.lastTick);
+    if (state.admitted && !priority && sinceLast < static_cast<std::uint64_t>(cooldown)) {
+        count<Stats>(totalCooldownSkipped);
+        // 隔离区块内的掉落物保持冻结
+        if (config.flowFastPath && !quarantine) flowStep(call.self, call.region, currentTick);
+        return true;
+    }
+    if (config.experiment && state.admitted) {
+        cohortStats[state.cohort].staleness.add(static_cast<double>(sinceLast));
+    }
+    if (config.catchUp && !quarantine && sinceLast > 1) catchUpMotion<Stats>(call.self, call.region, sinceLast - 1);
+    // 先记录放行 tick：origin() 中本实体可能被移除，之后 state 不再有效
+    std::uint8_t cohort = state.cohort;
+    state.lastTick      = currentTick;
+    state.admitted      = true;
+    ++state.admittedInWindow;
+    std::uint64_t chunk = state.chunk;
+    if (quarantine && quarantineMerge(call.self, *quarantine)) return true;
+
+    ++processedThisTick;
+    if constexpr (TokenBucket) {
+        tokenBalance -= 1.0;
+        if (processedThisTick > dynMaxPerTick) count<Stats>(totalBurstAdmitted);
+    }
+    bool liquid = config.flowFastPath && inLiquid(call.self);
+    if (liquid && state.liquidAdmit) learnFlow(call.self, call.region, currentTick);
+    state.liquidAdmit = liquid;
+    bool result;
+    if (++costSampleCounter % static_cast<std::uint64_t>(config.costSampleInterval) == 0) {
+        std::string typeName;
+        if (config.typeProfileSize > 0) typeName = static_cast<ItemActor&>(call.self).item().getTypeName();
+        auto start = std::chrono::steady_clock::now();
+        result     = call.run();
+        double ms  = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        itemCostMs = itemCostMs > 0.0 ? itemCostMs + 0.1 * (ms - itemCostMs) : ms;
+        // 采样值按采样间隔放大，近似本 tick 掉落物总耗时
+        itemMsThisTick += ms * config.costSampleInterval;
+        if (config.experiment) cohortStats[cohort].costUs.add(ms * 1000.0);
+        if (config.lagDetection) chunkWindows[chunk].costMs += ms * config.costSampleInterval;
+        if (config.chunkProfileSize > 0) chunkCost.add(chunk, ms * config.costSampleInterval);
+        if (liquid) liquidTickUs.add(ms * 1000.0);
+        if (config.typeProfileSize > 0) {
+            // 本实体可能已在 origin() 中被移除，类型名在调用前取得
+            typeCost.add(typeName, ms * config.costSampleInterval, config.costSampleInterval);
+        }
+        if (config.chunkBatching) directItemUs.add(ms * 1000.0);
+    } else if (config.chunkBatching) {
+        auto const& pos = call.self.getPosition();
+        BlockPos    bp{pos};
+        batchItems.push_back({call.self.getDimensionId().id, mortonKey(bp.x >> 4, bp.y >> 4, bp.z >> 4), id});
+        result = true;
+    } else {
+        result = call.run();
+    }
+    count<Stats>(totalProcessed);
+    return result;
+}
+
+// 按维度、Morton 序执行本 tick 入队的掉落物；在 Level tick 计时之内，控制器照常看到这部分耗时
+static void runBatch(Level& level) {
+    if (batchItems.empty()) return;
+    std::sort(batchItems.begin(), batchItems.end(), [](BatchEntry const& a, BatchEntry const& b) {
+        return a.dim != b.dim ? a.dim < b.dim : a.morton < b.morton;
+    });
+
+    // 只计 tick 本身，与直接 tick 的采样口径一致；查找实体与方块源不计入
+    std::chrono::steady_clock::duration elapsed{};
+    size_t                              ticked   = 0;
+    size_t                              vanished = 0;
+    {
+        PassthroughScope passthrough;
+        for (auto const& entry : batchItems) {
+            Actor* actor = level.fetchEntity(entry.id, false);
+            if (!actor || actor->isRemoved()) {
+                ++vanished;
+                continue;
+            }
+            auto& region = actor->getDimensionBlockSource();
+            auto  start  = std::chrono::steady_clock::now();
+            actor->tick(region);
+            elapsed += std::chrono::steady_clock::now() - start;
+            ++ticked;
+        }
+    }
+    batchItems.clear();
+    // 入队时已占用本 tick 的名额，没有执行的退回，控制器与令牌桶只看到实际执行的
+    if (vanished > 0) {
+        processedThisTick  -= static_cast<int>(vanished);
+        totalBatchVanished += vanished;
+        if (config.tokenBucket) tokenBalance += static_cast<double>(vanished);
+    }
+    if (ticked == 0) return;
+    double us = std::chrono::duration<double, std::micro>(elapsed).count();
+    batchedItemUs.add(us / static_cast<double>(ticked));
+}
+
+std::string batchReport() {
+    if (!config.chunkBatching) return "Batching: disabled";
+    return std::format(
+        "Batching: batched={:.2f}±{:.2f}us/item (n={} ticks), direct={:.2f}±{:.2f}us/item (n={}), "
+        "diff={:+.2f}±{:.2f}us, vanished={}",
+        batchedItemUs.mean, batchedItemUs.ci95(), batchedItemUs.count,
+        directItemUs.mean, directItemUs.ci95(), directItemUs.count,
+        batchedItemUs.mean - directItemUs.mean, diffCi95(directItemUs, batchedItemUs), totalBatchVanished
+    );
+}
+
+// Level tick 结束后用剩余时间补 tick 排队的掉落物，最久未放行的优先，返回耗时 ms；
+// 补 tick 经过掉落物 hook 时直接放行，跟踪状态在这里更新
+static double harvestSlack(Level& level, std::chrono::steady_clock::time_point deadline) {
+    if (deferredItems.empty()) return 0.0;
+    auto start = std::chrono::steady_clock::now();
+    if (start >= deadline) {
+        deferredItems.clear();
+        return 0.0;
+    }
+
+    std::uint64_t                                        now = level.getCurrentServerTick().tickID;
+    std::vector<std::pair<std::uint64_t, ActorUniqueID>> queue;
+    queue.reserve(deferredItems.size());
+    for (auto const& id : deferredItems) {
+        auto found = trackedItems.find(id);
+        queue.emplace_back(found != trackedItems.end() ? found->second.lastTick : 0, id);
+    }
+    deferredItems.clear();
+    std::sort(queue.begin(), queue.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+
+    PassthroughScope passthrough;
+    for (auto const& [lastTick, id] : queue) {
+        if (std::chrono::steady_clock::now() >= deadline) break;
+        Actor* actor = level.fetchEntity(id, false);
+        if (!actor || actor->isRemoved()) continue;
+        auto& region = actor->getDimensionBlockSource();
+        if (auto found = trackedItems.find(id); found != trackedItems.end()) {
+            if (!quarantined.empty() && quarantined.contains(found->second.chunk)) continue;
+            if (config.catchUp && ticksSince(now, lastTick) > 1) {
+                catchUpMotion<false>(*actor, region, ticksSince(now, lastTick) - 1);
+            }
+            found->second.lastTick    = now;
+            found->second.admitted    = true;
+            found->second.liquidAdmit = inLiquid(*actor);
+            ++found->second.admittedInWindow;
+        }
+        actor->tick(region);
+        ++totalSlackTicked;
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <bool Stats, bool UseRules>
+static AdmitFn pickAdmit(bool tokenBucket) {
+    return tokenBucket ? &admit<Stats, UseRules, true> : &admit<Stats, UseRules, false>;
+}
+
+template <bool Stats>
+static AdmitFn pickAdmit(bool useRules, bool tokenBucket) {
+    return useRules ? pickAdmit<Stats, true>(tokenBucket) : pickAdmit<Stats, false>(tokenBucket);
+}
+
+// 加载、启用、禁用时重新选择准入函数
+static void selectAdmitVariant(bool active) {
+    if (!active || !config.enabled) {
+        admitItem = &admitPassthrough;
+        return;
+    }
+    admitItem = config.debug ? pickAdmit<true>(!rules.empty(), config.tokenBucket)
+                             : pickAdmit<false>(!rules.empty(), config.tokenBucket);
+}
+
+// 实验或 SLO 需要拾取事件，按当前配置注册或移除监听
+static void removePickupListener() {
+    if (!pickupListener) return;
+    ll::event::EventBus::getInstance().removeListener(pickupListener);
+    pickupListener.reset();
+    playerDrops.clear();
+}
+
+static void updatePickupListener() {
+    if (!config.experiment && !config.sloMetrics) {
+        removePickupListener();
+        return;
+    }
+    if (pickupListener) return;
+    for (auto& c : cohortStats) c = {};
+    pickupLatencyHist.reset();
+    hopperLatencyHist.reset();
+    sloWindowElapsed  = 0;
+    pickupSloViolated = hopperSloViolated = false;
+    pickupListener = ll::event::EventBus::getInstance().emplaceListener<ll::event::PlayerPickUpItemEvent>(
+        [](ll::event::PlayerPickUpItemEvent& ev) {
+            auto found = trackedItems.find(ev.itemActor().getOrCreateUniqueID());
+            if (found == trackedItems.end()) return;
+            ItemState&    state = found->second;
+            std::uint64_t now   = ev.self().getLevel().getCurrentServerTick().tickID;
+            // 两次范围检查之间进入范围的，近似按上次放行计；拾取冷却结束前不算等待
+            std::uint64_t since = state.pickupRangeTick != 0 ? state.pickupRangeTick : state.lastTick;
+            since               = std::max(since, state.pickupReadyTick);
+            if (config.sloMetrics) pickupLatencyHist.add(ticksSince(now, since));
+            if (config.experiment) {
+                auto& stats = cohortStats[state.cohort];
+                stats.pickupLatency.add(static_cast<double>(ticksSince(now, since)));
+                stats.spawnToPickup.add(static_cast<double>(ticksSince(now, state.firstTick)));
+            }
+        }
+    );
+}
+
+// 热重载：后台线程解析、校验并编译规则，结果经原子指针交给主线程，在 Level tick 开始时应用
+struct PendingConfig {
+    Config    config;
+    RuleTable rules;
+};
+
+static FileWatcher                                 configWatcher;
+static std::atomic<std::shared_ptr<PendingConfig>> pendingConfig;
+
+// 监视线程自己的配置副本：启动监视前从当前配置复制，之后只在监视线程上读写
+static Config reloadBase;
+
+// 在监视线程上运行，不触碰任何全局状态，也从不写回 config.json。
+// 自己读取并以不抛异常的方式解析，文件缺的字段沿用当前值；半截、格式错误或版本不符的文件只告警
+static void reloadConfig() {
+    std::ifstream file(configPath());
+    if (!file) {
+        getLogger().warn("Failed to open config for reload, keeping current settings");
+        return;
+    }
+    auto json = nlohmann::ordered_json::parse(file, nullptr, false);
+    if (json.is_discarded() || !json.is_object()) {
+        getLogger().warn("config.json is not valid JSON, keeping current settings");
+        return;
+    }
+    if (!json.contains("version") || !json["version"].is_number_integer()
+        || json["version"].get<int>() != reloadBase.version)
+    {
+        getLogger().warn("config.json version does not match {}, keeping current settings", reloadBase.version);
+        return;
+    }
+    auto next    = std::make_shared<PendingConfig>();
+    next->config = reloadBase;
+    if (auto result = ll::reflection::deserialize<nlohmann::ordered_json>(next->config, json); !result) {
+        getLogger().warn("Invalid config.json, keeping current settings: {}", result.error().message());
+        return;
+    }
+    validateConfig(next->config);
+    reloadBase = next->config;
+    compileRules(next->rules, next->config.rules);
+    pendingConfig.store(std::move(next));
+}
+
+static void startConfigWatcher() {
+    if (config.configReloadSeconds <= 0) {
+        configWatcher.stop();
+        return;
+    }
+    configWatcher.stop();
+    reloadBase = config;
+    configWatcher.start(configPath(), std::chrono::seconds(config.configReloadSeconds), &reloadConfig);
+}
+
+static void applyPendingConfig(Level& level) {
+    auto next = pendingConfig.exchange(nullptr);
+    if (!next) return;
+
+    Config old = std::move(config);
+    config     = std::move(next->config);
+    rules      = std::move(next->rules);
+
+    // 控制器参数变化时重建，收敛状态沿用
+    if (old.controller != config.controller || old.maxPerTickStep != config.maxPerTickStep
+        || old.cooldownTicksStep != config.cooldownTicksStep || old.aimdDecrease != config.aimdDecrease
+        || old.mpcSmoothing != config.mpcSmoothing)
+    {
+        controller = makeController(
+            config.controller,
+            {config.maxPerTickStep, config.cooldownTicksStep, config.aimdDecrease, config.mpcSmoothing}
+        );
+    }
+    if (old.oscillationWindow != config.oscillationWindow
+        || old.oscillationCrossingRate != config.oscillationCrossingRate
+        || old.oscillationMinAmplitudeMs != config.oscillationMinAmplitudeMs
+        || old.oscillationCalmTicks != config.oscillationCalmTicks)
+    {
+        OscillationParams osc;
+        osc.window         = config.oscillationWindow;
+        osc.crossingRate   = config.oscillationCrossingRate;
+        osc.minAmplitudeMs = config.oscillationMinAmplitudeMs;
+        osc.calmTicks      = config.oscillationCalmTicks;
+        oscillation        = std::make_unique<OscillationDetector>(osc);
+    }
+    if (old.worldSpikeFactor != config.worldSpikeFactor || old.worldSpikeMinMs != config.worldSpikeMinMs
+        || old.worldSpikeMaxRun != config.worldSpikeMaxRun)
+    {
+        spikeFilter = std::make_unique<WorldSpikeFilter>(
+            SpikeFilterParams{config.worldSpikeFactor, config.worldSpikeMinMs, config.worldSpikeMaxRun}
+        );
+    }
+
+    // 规则类别编号随规则表变化，已跟踪掉落物的类别需重新计算
+    if (old.rules != config.rules) {
+        for (auto& [id, state] : trackedItems) {
+            Actor* actor    = level.fetchEntity(id, false);
+            state.typeClass = actor && !rules.empty()
+                                ? rules.typeClassOf(static_cast<ItemActor&>(*actor).item().getTypeName())
+                                : 0;
+        }
+    }
+
+    if (config.debug) startDebugTask();
+    else stopDebugTask();
+    if (config.snapshotIntervalSeconds > 0) startSnapshotTask();
+    else stopSnapshotTask();
+    if (config.experiment) startExperimentTask();
+    else stopExperimentTask();
+    updatePickupListener();
+
+    if (old.dropLimit != config.dropLimit) setDropLimiterActive(config.dropLimit);
+    if (!config.superStacks) splitAllSuperStacks(level);
+    if (!config.lagDetection) {
+        chunkWindows.clear();
+        quarantined.clear();
+    }
+    if (config.censusItemsPerTick == 0) {
+        census.reset();
+        censusBucketCount = 0;
+    }
+    if (old.chunkProfileSize != config.chunkProfileSize) chunkCost.resize(config.chunkProfileSize);
+    if (old.typeProfileSize != config.typeProfileSize) typeCost.resize(config.typeProfileSize);
+    flowField.setMaxAge(config.flowCellTicks);
+    if (!config.flowFastPath) flowField.clear();
+    if (!old.tokenBucket && config.tokenBucket) tokenBalance = tokenRefillRate;
+    if (old.configReloadSeconds != config.configReloadSeconds) startConfigWatcher();
+    selectAdmitVariant(true);
+
+    getLogger().info(
+        "Config reloaded: enabled={}, controller={}, targetTickMs={}, rules={}, tracked={} kept",
+        config.enabled, controller->name(), config.targetTickMs, rules.ruleCount(), trackedItems.size()
+    );
+}
 
 Optimizer& Optimizer::getInstance() {
     static Optimizer instance;
@@ -111,7 +1616,9 @@ bool Optimizer::load() {
         getLogger().warn("Failed to load config, using defaults and saving");
         saveConfig();
     }
-    lastItemTick.reserve(config.initialMapReserve);
+    trackedItems.reserve(config.initialMapReserve);
+    compileRules(rules, config.rules);
+    selectAdmitVariant(false);
     getLogger().info(
         "Loaded. enabled={}, debug={}, targetTickMs={}",
         config.enabled, config.debug, config.targetTickMs
@@ -120,23 +1627,107 @@ bool Optimizer::load() {
 }
 
 bool Optimizer::enable() {
-    dynMaxPerTick    = config.maxPerTickStep    * 10;
-    dynCooldownTicks = config.cooldownTicksStep * 2;
+    controller = makeController(
+        config.controller,
+        {config.maxPerTickStep, config.cooldownTicksStep, config.aimdDecrease, config.mpcSmoothing}
+    );
+    OscillationParams osc;
+    osc.window         = config.oscillationWindow;
+    osc.crossingRate   = config.oscillationCrossingRate;
+    osc.minAmplitudeMs = config.oscillationMinAmplitudeMs;
+    osc.calmTicks      = config.oscillationCalmTicks;
+    oscillation        = std::make_unique<OscillationDetector>(osc);
+    spikeFilter        = std::make_unique<WorldSpikeFilter>(
+        SpikeFilterParams{config.worldSpikeFactor, config.worldSpikeMinMs, config.worldSpikeMaxRun}
+    );
+
+    bool restored = loadSnapshot();
+    if (!restored) {
+        controlState.maxPerTick    = config.maxPerTickStep * 10;
+        controlState.cooldownTicks = config.cooldownTicksStep * 2;
+    }
+    clampControlState(controlState);
+    warmupTicksLeft = config.warmupSeconds * 20;
+    warmupStableRun = 0;
+    dynMaxPerTick    = static_cast<int>(controlState.maxPerTick);
+    dynCooldownTicks = static_cast<int>(controlState.cooldownTicks);
+    tokenRefillRate  = dynMaxPerTick;
+    tokenBalance     = tokenRefillRate;
 
     if (config.debug) startDebugTask();
+    startSnapshotTask();
+    registerCommand();
+    setDropLimiterActive(config.dropLimit);
+    chunkCost.resize(config.chunkProfileSize);
+    typeCost.resize(config.typeProfileSize);
+    profileElapsed = 0;
+    setVirtualItemsActive(true);
+    setSuperStacksActive(true);
+    flowField.setMaxAge(config.flowCellTicks);
+    liquidTickUs.reset();
+    flowStepUs.reset();
+    directItemUs.reset();
+    batchedItemUs.reset();
+    totalBatchVanished = 0;
+    selectAdmitVariant(true);
+
+    updatePickupListener();
+    startExperimentTask();
+    startConfigWatcher();
+
     getLogger().info(
-        "Enabled. initMaxPerTick={}, initCooldown={}",
-        dynMaxPerTick, dynCooldownTicks
+        "Enabled. controller={}, initMaxPerTick={}, initCooldown={} ({}), warmup={}s",
+        controller->name(), dynMaxPerTick, dynCooldownTicks,
+        restored ? "restored" : "default", config.warmupSeconds
     );
     return true;
 }
 
 bool Optimizer::disable() {
+    selectAdmitVariant(false);
+    if (auto level = ll::service::getLevel()) {
+        splitAllSuperStacks(*level);
+        if (size_t left = rematerializeAll(*level)) {
+            getLogger().info("{} virtual items are in unloaded chunks, kept in the data directory", left);
+        }
+    }
+    setVirtualItemsActive(false);
+    setSuperStacksActive(false);
+    setDropLimiterActive(false);
+    chunkWindows.clear();
+    quarantined.clear();
+    lagWindowElapsed = 0;
+    lagWindowTickMs  = 0.0;
+    census.reset();
+    censusBucketCount = 0;
+    censusNextTick    = 0;
+    flowField.clear();
+    deferredItems.clear();
+    batchItems.clear();
     stopDebugTask();
-    lastItemTick.clear();
+    stopSnapshotTask();
+    if (experimentTask.running) logExperiment();
+    stopExperimentTask();
+    configWatcher.stop();
+    pendingConfig.store(nullptr);
+    removePickupListener();
+    if (controller && !saveSnapshot()) getLogger().warn("Failed to save controller snapshot");
+    trackedItems.clear();
+    fairnessRetired.clear();
     processedThisTick = 0;
     lastTickId        = 0;
     cleanupCounter    = 0;
+    tokenBalance      = 0.0;
+    itemCostMs        = 0.0;
+    costSampleCounter = 0;
+    itemMsThisTick    = 0.0;
+    spawnedThisTick   = 0;
+    removedThisTick   = 0;
+    spawnRate         = 0.0;
+    growthRate        = 0.0;
+    controller.reset();
+    oscillation.reset();
+    spikeFilter.reset();
     resetStats();
     getLogger().info("Disabled");
     return true;
@@ -155,50 +1746,16 @@ LL_AUTO_TYPE_INSTANCE_HOOK(
 ) {
     using namespace tps_item_optimizer;
 
-    if (!config.enabled || !this->hasCategory(ActorCategory::Item)) {
-        return origin(region);
-    }
-
-    std::uint64_t currentTick = this->getLevel().getCurrentServerTick().tickID;
-
-    if (currentTick != lastTickId) {
-        lastTickId        = currentTick;
-        processedThisTick = 0;
-
-        if (++cleanupCounter >= config.cleanupIntervalTicks) {
-            cleanupCounter = 0;
-            for (auto it = lastItemTick.begin(); it != lastItemTick.end();) {
-                if (currentTick - it->second >
-                    static_cast<std::uint64_t>(config.maxExpiredAge))
-                {
-                    it = lastItemTick.erase(it);
-                    ++totalExpiredCleaned;
-                } else {
-                    ++it;
-                }
-            }
-        }
-    }
-
-    if (processedThisTick >= dynMaxPerTick) {
-        ++totalThrottleSkipped;
-        return true;
-    }
-
-    auto [it, inserted] = lastItemTick.emplace(this->getOrCreateUniqueID(), 0);
-    if (!inserted &&
-        currentTick - it->second <
-            static_cast<std::uint64_t>(dynCooldownTicks))
-    {
-        ++totalCooldownSkipped;
-        return true;
-    }
-
-    ++processedThisTick;
-    bool result = origin(region);
-    it->second  = currentTick;
-    ++totalProcessed;
-    return result;
+    if (admitItem == &admitPassthrough || !this->hasCategory(ActorCategory::Item)) return origin(region);
+    // 没有超级堆叠时只是一次 empty() 判断
+    if (hasSuperStacks()) topUpSuperStack(static_cast<ItemActor&>(static_cast<Actor&>(*this)));
+    TickCall call{
+        *this,
+        region,
+        [](void* hook, BlockSource& r) { return static_cast<ItemActorTickHook*>(hook)->origin(r); },
+        this
+    };
+    return admitItem(call);
 }
 
 // ── Level::$tick Hook：测耗时动态调整 ────────────────────
@@ -211,22 +1768,113 @@ LL_AUTO_TYPE_INSTANCE_HOOK(
 ) {
     using namespace tps_item_optimizer;
 
+    if (controller) applyPendingConfig(*this);
+
     auto tickStart = std::chrono::steady_clock::now();
     origin();
+    runBatch(*this);
 
-    if (!config.enabled) return;
+    // 插件禁用后仍继续还原遗留的虚拟记录、写回超级堆叠旁表
+    if (config.virtualize || hasVirtualItems()) updateVirtualItems(*this);
+    updateSuperStacks();
+
+    if (!config.enabled || !controller || !oscillation || !spikeFilter) {
+        deferredItems.clear();
+        return;
+    }
 
-    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+    double elapsed = std::chrono::duration<double, std::milli>(
         std::chrono::steady_clock::now() - tickStart
     ).count();
 
-    if (elapsed > config.targetTickMs) {
-        dynMaxPerTick    = std::max(8,   dynMaxPerTick    - config.maxPerTickStep);
-        dynCooldownTicks = std::min(10,  dynCooldownTicks + config.cooldownTicksStep);
-    } else {
-        dynMaxPerTick    = std::min(200, dynMaxPerTick    + config.maxPerTickStep);
-        dynCooldownTicks = std::max(1,   dynCooldownTicks - config.cooldownTicksStep);
+    // 余量收割在测量之后进行，控制器看到的仍是本 tick 的真实负载；mspt 统计计入收割耗时
+    double slackMs = 0.0;
+    if (config.slackHarvest) {
+        slackMs = harvestSlack(
+            *this,
+            tickStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::milli>(config.targetTickMs - config.slackMarginMs)
+            )
+        );
+    }
+
+    if (config.sloMetrics) updateSloWindow();
+    updateFairnessWindow();
+
+    double itemMs  = itemMsThisTick;
+    itemMsThisTick = 0.0;
+    ++statTicks;
+    statTickMs += elapsed + slackMs;
+    statSlackMs += slackMs;
+    statItemMs += itemMs;
+    if (config.censusItemsPerTick > 0) updateCensus(*this);
+    if (config.lagDetection) updateLagWindow(*this, elapsed);
+    updateProfiles();
+
+    spawnRate       += 0.1 * (spawnedThisTick - spawnRate);
+    growthRate      += 0.1 * (spawnedThisTick - removedThisTick - growthRate);
+    spawnedThisTick  = 0;
+    removedThisTick  = 0;
+
+    bool itemTarget = config.controlTarget == "item";
+
+    // 存档、区块生成等造成的尖峰单独记录；按总耗时控制时不交给控制器
+    if (config.worldSpikeFilter && spikeFilter->update(elapsed - itemMs)) {
+        ++statSpikeTicks;
+        statSpikeMs += elapsed;
+        if (!itemTarget) return;
+    }
+
+    // 预热期间区块加载拖慢 tick，与掉落物无关
+    bool warmingUp = warmupTicksLeft > 0;
+    if (warmingUp) {
+        warmupStableRun = elapsed <= config.targetTickMs ? warmupStableRun + 1 : 0;
+        if (--warmupTicksLeft == 0 || warmupStableRun >= config.warmupStableTicks) {
+            warmupTicksLeft = 0;
+            getLogger().info("Warmup finished, controller active");
+        } else if (config.warmupDamping <= 0.0) {
+            return;
+        }
+    }
+
+    ControlInput in;
+    in.tickMs     = itemTarget ? itemMs : elapsed;
+    in.targetMs   = itemTarget ? config.targetItemTickMs : config.targetTickMs;
+    in.processed  = processedThisTick;
+    in.itemCount  = trackedItems.size();
+    in.itemCostMs = itemCostMs;
+
+    in.feedforwardMs = feedforwardMs(
+        {config.feedforwardCountGain, config.feedforwardSpawnGain},
+        spawnRate,
+        growthRate,
+        itemCostMs
+    );
+
+    switch (oscillation->update(in.errorMs())) {
+    case OscillationDetector::Event::Damped:
+        getLogger().info(
+            "Oscillation detected (crossingRate={:.2f}, amplitude={:.1f}ms): gainScale={:.3f}, deadband={:.1f}ms",
+            oscillation->crossingRate(), oscillation->amplitudeMs(),
+            oscillation->gainScale(), oscillation->deadbandMs()
+        );
+        break;
+    case OscillationDetector::Event::Restored:
+        getLogger().info(
+            "Controller calm: gainScale={:.3f}, deadband={:.1f}ms",
+            oscillation->gainScale(), oscillation->deadbandMs()
+        );
+        break;
+    default:
+        break;
     }
+    in.gainScale  = oscillation->gainScale() * (warmingUp && warmupTicksLeft > 0 ? config.warmupDamping : 1.0);
+    in.deadbandMs = oscillation->deadbandMs();
+    controller->update(in, controlState);
+
+    dynMaxPerTick    = static_cast<int>(controlState.maxPerTick);
+    dynCooldownTicks = static_cast<int>(std::lround(controlState.cooldownTicks));
+    tokenRefillRate  = dynMaxPerTick;
 }
 
 // ── 清理 Hook ─────────────────────────────────────────────
@@ -238,9 +1886,13 @@ LL_AUTO_TYPE_INSTANCE_HOOK(
     void
 ) {
     using namespace tps_item_optimizer;
+    if (hasSuperStacks()) onSuperStackDespawned(this->getOrCreateUniqueID());
     if (config.enabled) {
-        if (lastItemTick.erase(this->getOrCreateUniqueID()) > 0)
+        if (auto found = trackedItems.find(this->getOrCreateUniqueID()); found != trackedItems.end()) {
+            retireFromFairness(found->second);
+            trackedItems.erase(found);
             ++totalDespawnCleaned;
+        }
     }
     origin();
 }
@@ -253,11 +1905,29 @@ LL_AUTO_TYPE_INSTANCE_HOOK(
     void
 ) {
     using namespace tps_item_optimizer;
-    if (config.enabled) {
-        if (lastItemTick.erase(this->getOrCreateUniqueID()) > 0)
-            ++totalDespawnCleaned;
+    if (config.enabled) onItemRemoved(*this);
+    if (config.enabled && this->hasCategory(ActorCategory::Item)) ++removedThisTick;
+    if (hasSuperStacks() && this->hasCategory(ActorCategory::Item)) {
+        onSuperStackRemoved(static_cast<ItemActor&>(static_cast<Actor&>(*this)));
     }
     origin();
 }
 
+// 漏斗吸入掉落物时整堆吸完会在其中移除掉落物，据此区分漏斗吸入与其他移除
+LL_AUTO_TYPE_INSTANCE_HOOK(
+    HopperAddItemHook,
+    ll::memory::HookPriority::Normal,
+    Hopper,
+    &Hopper::_addItem,
+    bool,
+    Container& container,
+    ItemActor& item
+) {
+    using namespace tps_item_optimizer;
+    hopperPulling = &item;
+    bool added    = origin(container, item);
+    hopperPulling = nullptr;
+    return added;
+}
+
 LL_REGISTER_MOD(tps_item_optimizer::Optimizer, tps_item_optimizer::Optimizer::getInstance());
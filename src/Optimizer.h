@@ -2,13 +2,16 @@
 #include <ll/api/Config.h>
 #include <ll/api/io/Logger.h>
 #include <ll/api/mod/NativeMod.h>
+#include <string>
 #include <unordered_map>
+#include <vector>
+#include <cstdint>
 #include <mc/legacy/ActorUniqueID.h>
 
 namespace tps_item_optimizer {
 
 struct Config {
-    int  version = 1;
+    int  version = 26;
     bool enabled = true;
     bool debug   = false;
 
@@ -17,16 +20,191 @@ struct Config {
     int maxPerTickStep    = 2;
     int cooldownTicksStep = 1;
 
+    // 控制策略：step | aimd | mpc
+    std::string controller         = "step";
+    double      aimdDecrease       = 0.5;
+    double      mpcSmoothing       = 0.3;
+    int         costSampleInterval = 16; // 每 N 个放行的掉落物计时一次，学习单个耗时
+
+    // 控制对象：total 为整个 Level tick 耗时，item 为掉落物 origin() 耗时（按采样放大估算）
+    std::string controlTarget    = "total";
+    int         targetItemTickMs = 20;
+
+    // 世界事件尖峰识别：非掉落物耗时突增的 tick 不参与控制
+    bool   worldSpikeFilter = true;
+    double worldSpikeFactor = 2.0;
+    double worldSpikeMinMs  = 15.0;
+    int    worldSpikeMaxRun = 100;
+
+    // 启动预热：加载区块期间忽略（damping=0）或衰减控制器输入，
+    // 持续 warmupSeconds 或连续 warmupStableTicks 个 tick 达标后结束
+    int    warmupSeconds     = 60;
+    int    warmupStableTicks = 100;
+    double warmupDamping     = 0.0;
+
+    // 控制器状态定期落盘间隔（秒），0 表示仅在 disable 时保存
+    int snapshotIntervalSeconds = 300;
+
+    // A/B 实验：按实体 ID 哈希确定性分组，两组各用自己的冷却倍数。拾取延迟分两种口径报告：
+    // pickupLatency 从进入拾取范围算起（同 SLO），spawnToPickup 从首次出现算起
+    bool   experiment                       = false;
+    int    experimentTreatmentPercent       = 50;
+    double experimentControlCooldownScale   = 1.0;
+    double experimentTreatmentCooldownScale = 2.0;
+    int    experimentReportSeconds          = 60;
+
+    // 玩家可见延迟 SLO：进入拾取/漏斗范围到被拾取/吸入的 tick 数，拾取从原版拾取冷却结束起算，
+    // 漏斗只计真正被漏斗吸入的；窗口内 p95 超过 SLO 时，范围内的掉落物绕过限流优先放行。
+    // 每个掉落物每 sloProbeInterval 次准入检查探测一次是否在范围内，离开范围后重新计时。SLO 上限 250 tick
+    bool   sloMetrics       = true;
+    double pickupRange      = 2.0;
+    int    sloProbeInterval = 4;
+    int    sloWindowTicks   = 1200;
+    int    sloPickupTicks   = 10;
+    int    sloHopperTicks   = 20;
+
+    // 公平性统计窗口与报告中列出的最差区块数
+    int fairnessWindowTicks = 1200;
+    int fairnessWorstChunks = 5;
+
+    // 声明式规则，语法见 Rules.h，例如
+    // "when item in [cobblestone] and distance > 48 and state == resting then cooldown 20"
+    std::vector<std::string> rules;
+
+    // 掉落物生成限速：按玩家 / 发射器与投掷器 / 区块的令牌桶，
+    // 超限时合并进同来源已有的掉落物而非删除
+    bool   dropLimit                = true;
+    double dropLimitPlayerPerSecond = 20.0;
+    int    dropLimitPlayerBurst     = 64;
+    double dropLimitBlockPerSecond  = 8.0;
+    int    dropLimitBlockBurst      = 32;
+    double dropLimitChunkPerSecond  = 100.0;
+    int    dropLimitChunkBurst      = 200;
+    double dropMergeRadius          = 8.0;
+
+    // 刷物机检测：区块的掉落物生成速率、tick 耗时占比或数量连续 lagStrikes 个窗口超标即隔离，
+    // 隔离期间区块内掉落物几乎冻结并积极合并
+    bool   lagDetection            = true;
+    int    lagWindowTicks          = 200;
+    int    lagStrikes              = 3;
+    double lagSpawnPerSecond       = 40.0;
+    double lagCostShare            = 0.25;
+    int    lagItemCount            = 400;
+    int    quarantineSeconds       = 300;
+    int    quarantineCooldownTicks = 100;
+    double quarantineMergeRadius   = 4.0;
+
+    // 掉落物普查：每 tick 最多检查 censusItemsPerTick 个掉落物，遍历完成后发布快照，
+    // 间隔 censusIntervalSeconds 开始下一轮；0 关闭
+    int censusItemsPerTick    = 128;
+    int censusIntervalSeconds = 10;
+
+    // 前馈：掉落物激增时在 MSPT 超标前提前收紧。输入为生成 hook 统计的真实生成速率（spawnGain）
+    // 与掉落物数量的净增长速率（countGain）
+    double feedforwardCountGain = 0.5;
+    double feedforwardSpawnGain = 1.0;
+
+    // 振荡检测与增益调度
+    int    oscillationWindow         = 40;
+    double oscillationCrossingRate   = 0.35;
+    double oscillationMinAmplitudeMs = 2.0;
+    int    oscillationCalmTicks      = 200;
+
+    // 令牌桶准入：空闲 tick 未用完的名额累积为信用，供后续 tick 消化积压
+    bool tokenBucket = false;
+    int  tokenBurst  = 100;
+
+    // 液体流场快速路径：被限流或冷却的液体中掉落物按缓存的流速平移，不走原版 tick；
+    // 流速从原版 tick 学习，超过 flowCellTicks 未刷新即过期
+    bool flowFastPath  = true;
+    int  flowCellTicks = 200;
+
+    // 掉落物虚拟化：普查时发现离玩家超过 virtualizeDistance 且静止超过 virtualizeAfterSeconds 的
+    // 掉落物转为区块内的数据记录；玩家进入 virtualizeDistance - virtualizeGuard、下方出现漏斗
+    // 或区块保存时还原为实体，每 tick 最多还原 rematerializePerTick 个。记录先追加到数据目录的
+    // virtual_items.log 再移除实体，禁用或崩溃后下次启用时载入。还原后的墓碑与本批生成在同一 tick
+    // 交给后台线程写入，崩溃时只有最后几毫秒内还原的掉落物可能被再次还原，不会丢失。依赖普查
+    bool   virtualize             = false;
+    double virtualizeDistance     = 96.0;
+    double virtualizeGuard        = 16.0;
+    int    virtualizeAfterSeconds = 60;
+    int    rematerializePerTick   = 32;
+
+    // 超级堆叠：普查时把同区块内 superStackRadius 以内的同类静止掉落物并入一个实体，
+    // 单个实体最多携带 superStackLimit 个物品；拾取、漏斗吸入、区块保存时透明拆分。
+    // 余量旁表保存在数据目录的 super_stacks.json。依赖普查
+    bool   superStacks      = false;
+    double superStackRadius = 2.0;
+    int    superStackLimit  = 4096;
+
+    // 追赶积分：被冷却跳过若干 tick 的空中掉落物，放行时先补上跳过期间的重力与阻力，
+    // 按 tick 细分并在碰到非空气方块前停下，使下落与漂移保持实时速度；最多补 catchUpMaxTicks
+    bool catchUp         = true;
+    int  catchUpMaxTicks = 20;
+
+    // 余量收割：本 tick 被限流的掉落物排队，Level tick 结束后若离 targetTickMs 还有余量，
+    // 按上次放行的先后补 tick，直到距目标只剩 slackMarginMs；这部分耗时不计入控制器输入，计入 mspt 统计。
+    // 余量只按 Level tick 的耗时估算，看不到网络、区块加载等 Level 之外的耗时，这些较重的服务器上
+    // 会把 tick 推过目标，因此默认关闭
+    bool   slackHarvest  = false;
+    double slackMarginMs = 5.0;
+
+    // 按区块批量 tick：放行的掉落物先入队，Level tick 结束时按子区块 Morton 序集中执行，
+    // 相邻掉落物共享已在缓存中的方块与碰撞数据；采样的掉落物仍直接 tick，作为对照
+    bool chunkBatching = false;
+
+    // 耗时画像：采样到的掉落物 tick 耗时按区块 / 物品类型累计进固定大小的 top-K 草图，
+    // 每秒按 profileDecay 衰减；Size 为 0 关闭对应画像
+    int    chunkProfileSize = 64;
+    int    typeProfileSize  = 32;
+    double profileDecay     = 0.95;
+
+    // 热重载：轮询 config.json 的间隔（秒），0 关闭；跟踪状态保留
+    int configReloadSeconds = 2;
+
     // 内部维护
     int cleanupIntervalTicks = 100;
     int maxExpiredAge        = 600;
     int initialMapReserve    = 500;
 };
 
+// 控制器收敛状态，disable 时及定期保存，enable 时恢复
+struct ControllerSnapshot {
+    int    version       = 2;
+    bool   valid         = false;
+    double maxPerTick    = 0.0;
+    double cooldownTicks = 0.0;
+
+    // 耗时模型
+    double itemCostMs      = 0.0;
+    double spawnRate       = 0.0;
+    double spikeBaselineMs = 0.0;
+    double gainScale       = 1.0;
+    double deadbandMs      = 0.0;
+
+    // 控制策略自身的模型表，仅在策略相同时恢复
+    std::string         controller;
+    std::vector<double> model;
+};
+
 Config& getConfig();
 bool    loadConfig();
 bool    saveConfig();
 
+// 报告（供 /tpsitem 命令使用）
+std::string fairnessReport();
+std::string censusReport();
+std::string chunkCostReport();
+std::string typeCostReport();
+std::string flowReport();
+std::string batchReport();
+
+// 生成 hook 调用：按所在区块统计真实生成的掉落物，插件自己还原、拆分的不计；
+// 玩家丢出的另记下来，拾取延迟按更长的原版拾取冷却起算
+void countItemSpawn(ActorUniqueID const& id, std::uint64_t chunk, bool thrownByPlayer);
+
+void registerCommand();
+
 class Optimizer {
 public:
     static Optimizer& getInstance();
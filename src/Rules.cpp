@@ -0,0 +1,280 @@
+#include "Rules.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <format>
+#include <limits>
+
+namespace tps_item_optimizer {
+
+namespace {
+
+constexpr float kInf = std::numeric_limits<float>::infinity();
+
+struct ParsedRule {
+    int          typeSet    = -1; // mSets 下标，-1 表示不限物品
+    bool         typeNegate = false;
+    float        minDist    = 0.0f; // distance ∈ [minDist, maxDist)
+    float        maxDist    = kInf;
+    std::uint8_t motionMask = 0b111;
+    RuleAction   action;
+};
+
+bool isPunct(char c) { return c == '[' || c == ']' || c == ','; }
+bool isOp(char c) { return c == '<' || c == '>' || c == '=' || c == '!'; }
+bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+std::vector<std::string_view> tokenize(std::string_view src) {
+    std::vector<std::string_view> out;
+    size_t                        i = 0;
+    while (i < src.size()) {
+        if (isSpace(src[i])) {
+            ++i;
+            continue;
+        }
+        size_t start = i;
+        if (isPunct(src[i])) {
+            ++i;
+        } else if (isOp(src[i])) {
+            while (i < src.size() && isOp(src[i])) ++i;
+        } else {
+            while (i < src.size() && !isSpace(src[i]) && !isPunct(src[i]) && !isOp(src[i])) ++i;
+        }
+        out.push_back(src.substr(start, i - start));
+    }
+    return out;
+}
+
+std::string normalizeType(std::string_view name) {
+    if (name.find(':') != std::string_view::npos) return std::string{name};
+    return "minecraft:" + std::string{name};
+}
+
+bool parseMotion(std::string_view name, std::uint8_t& mask) {
+    if (name == "resting") mask = 1 << static_cast<int>(ItemMotion::Resting);
+    else if (name == "moving") mask = 1 << static_cast<int>(ItemMotion::Moving);
+    else if (name == "liquid") mask = 1 << static_cast<int>(ItemMotion::Liquid);
+    else return false;
+    return true;
+}
+
+template <class T>
+bool parseNumber(std::string_view tok, T& out) {
+    auto [ptr, ec] = std::from_chars(tok.data(), tok.data() + tok.size(), out);
+    return ec == std::errc{} && ptr == tok.data() + tok.size();
+}
+
+class Parser {
+public:
+    Parser(std::string_view src, std::vector<std::vector<std::string>>& sets) : mToks(tokenize(src)), mSets(sets) {}
+
+    bool parse(ParsedRule& rule, std::string& error) {
+        if (!expect("when", error)) return false;
+        do {
+            if (!parseCondition(rule, error)) return false;
+        } while (accept("and"));
+        if (!expect("then", error)) return false;
+
+        auto action = next();
+        if (action == "cooldown") {
+            int ticks = 0;
+            if (!parseNumber(next(), ticks) || ticks < 1) {
+                error = "cooldown expects a positive tick count";
+                return false;
+            }
+            rule.action = {RuleAction::Kind::Cooldown, ticks};
+        } else if (action == "priority") {
+            rule.action = {RuleAction::Kind::Priority, 0};
+        } else {
+            error = std::format("unknown action '{}'", action);
+            return false;
+        }
+        if (mPos != mToks.size()) {
+            error = std::format("unexpected '{}' after action", mToks[mPos]);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::string_view next() { return mPos < mToks.size() ? mToks[mPos++] : std::string_view{}; }
+
+    bool accept(std::string_view tok) {
+        if (mPos < mToks.size() && mToks[mPos] == tok) {
+            ++mPos;
+            return true;
+        }
+        return false;
+    }
+
+    bool expect(std::string_view tok, std::string& error) {
+        if (accept(tok)) return true;
+        error = std::format("expected '{}'", tok);
+        return false;
+    }
+
+    bool parseCondition(ParsedRule& rule, std::string& error) {
+        auto subject = next();
+        if (subject == "item") {
+            if (rule.typeSet >= 0) {
+                error = "only one item condition per rule";
+                return false;
+            }
+            rule.typeNegate = accept("not");
+            if (!expect("in", error) || !expect("[", error)) return false;
+            std::vector<std::string> names;
+            while (!accept("]")) {
+                auto name = next();
+                if (name.empty() || isPunct(name[0])) {
+                    error = "malformed item list";
+                    return false;
+                }
+                names.push_back(normalizeType(name));
+                accept(",");
+            }
+            rule.typeSet = static_cast<int>(mSets.size());
+            mSets.push_back(std::move(names));
+            return true;
+        }
+        if (subject == "distance") {
+            auto  op    = next();
+            float value = 0.0f;
+            if (!parseNumber(next(), value) || value < 0.0f) {
+                error = "distance expects a non-negative number";
+                return false;
+            }
+            // 距离是连续量，> 与 >=、< 与 <= 不作区分
+            if (op == ">" || op == ">=") rule.minDist = std::max(rule.minDist, value);
+            else if (op == "<" || op == "<=") rule.maxDist = std::min(rule.maxDist, value);
+            else {
+                error = std::format("unknown distance operator '{}'", op);
+                return false;
+            }
+            return true;
+        }
+        if (subject == "state") {
+            auto         op   = next();
+            std::uint8_t mask = 0;
+            if (!parseMotion(next(), mask)) {
+                error = "state expects resting, moving or liquid";
+                return false;
+            }
+            if (op == "==") rule.motionMask &= mask;
+            else if (op == "!=") rule.motionMask &= static_cast<std::uint8_t>(~mask);
+            else {
+                error = std::format("unknown state operator '{}'", op);
+                return false;
+            }
+            return true;
+        }
+        error = std::format("unknown condition '{}'", subject);
+        return false;
+    }
+
+    std::vector<std::string_view>          mToks;
+    size_t                                 mPos = 0;
+    std::vector<std::vector<std::string>>& mSets;
+};
+
+} // namespace
+
+bool RuleTable::compile(std::vector<std::string> const& rules, std::string& error) {
+    *this = {};
+    if (rules.empty()) return true;
+    if (rules.size() > 64) {
+        error = "at most 64 rules are supported";
+        return false;
+    }
+
+    std::vector<std::vector<std::string>> sets;
+    std::vector<ParsedRule>               parsed(rules.size());
+    for (size_t i = 0; i < rules.size(); ++i) {
+        Parser parser{rules[i], sets};
+        if (!parser.parse(parsed[i], error)) {
+            error = std::format("rule {}: {}", i + 1, error);
+            return false;
+        }
+    }
+
+    // 每个类型名按所属列表得到位掩码，相同掩码的类型合并为一个类别
+    std::unordered_map<std::string, std::uint64_t> typeMask;
+    for (size_t s = 0; s < sets.size(); ++s) {
+        for (auto const& name : sets[s]) typeMask[name] |= std::uint64_t{1} << s;
+    }
+    std::vector<std::uint64_t>                      classMasks{0};
+    std::unordered_map<std::uint64_t, std::uint8_t> maskClass{{0, 0}};
+    for (auto const& [name, mask] : typeMask) {
+        auto [it, inserted] = maskClass.try_emplace(mask, static_cast<std::uint8_t>(classMasks.size()));
+        if (inserted) {
+            if (classMasks.size() >= 255) {
+                error = "too many distinct item lists";
+                *this = {};
+                return false;
+            }
+            classMasks.push_back(mask);
+        }
+        mTypeClass.emplace(name, it->second);
+    }
+
+    // 所有距离阈值切分出的区间
+    for (auto const& r : parsed) {
+        if (r.minDist > 0.0f) mBounds.push_back(r.minDist);
+        if (r.maxDist < kInf) mBounds.push_back(r.maxDist);
+    }
+    std::sort(mBounds.begin(), mBounds.end());
+    mBounds.erase(std::unique(mBounds.begin(), mBounds.end()), mBounds.end());
+
+    mClasses     = classMasks.size();
+    mBuckets     = mBounds.size() + 1;
+    mRuleCount   = parsed.size();
+    mHasPriority = std::any_of(parsed.begin(), parsed.end(), [](ParsedRule const& r) {
+        return r.action.kind == RuleAction::Kind::Priority;
+    });
+    mTable.assign(mClasses * mBuckets * static_cast<size_t>(ItemMotion::Count), {});
+
+    for (size_t c = 0; c < mClasses; ++c) {
+        for (size_t b = 0; b < mBuckets; ++b) {
+            float lo = b == 0 ? 0.0f : mBounds[b - 1];
+            for (size_t m = 0; m < static_cast<size_t>(ItemMotion::Count); ++m) {
+                for (auto const& r : parsed) {
+                    if (r.typeSet >= 0 && ((classMasks[c] >> r.typeSet & 1) != 0) == r.typeNegate) continue;
+                    if (lo < r.minDist || lo >= r.maxDist) continue;
+                    if ((r.motionMask >> m & 1) == 0) continue;
+                    mTable[(c * mBuckets + b) * static_cast<size_t>(ItemMotion::Count) + m] = r.action;
+                    break;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+std::uint8_t RuleTable::typeClassOf(std::string_view typeName) const {
+    auto it = mTypeClass.find(std::string{typeName});
+    return it == mTypeClass.end() ? 0 : it->second;
+}
+
+double RuleTable::benchmarkNs(size_t iterations) const {
+    if (empty() || iterations == 0) return 0.0;
+    std::uint32_t rng = 0x9E3779B9u;
+    // volatile 防止循环被整体优化掉
+    volatile int  sink = 0;
+    auto          next = [&rng] {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng;
+    };
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        std::uint32_t r      = next();
+        auto          cls    = static_cast<std::uint8_t>(r % mClasses);
+        auto          dist   = static_cast<float>((r >> 8) % 160);
+        auto          motion = static_cast<ItemMotion>((r >> 16) % static_cast<std::uint32_t>(ItemMotion::Count));
+        sink                 = sink + static_cast<int>(evaluate(cls, dist, motion).kind);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(iterations);
+}
+
+} // namespace tps_item_optimizer
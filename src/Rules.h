@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace tps_item_optimizer {
+
+// 规则动作，按规则顺序首个命中者生效
+struct RuleAction {
+    enum class Kind : std::uint8_t { None, Cooldown, Priority };
+
+    Kind kind  = Kind::None;
+    int  value = 0;
+};
+
+enum class ItemMotion : std::uint8_t { Resting, Moving, Liquid, Count };
+
+// 规则语言示例：
+//   when item in [cobblestone, dirt] and distance > 48 and state == resting then cooldown 20
+//   when state == liquid then priority
+// 条件：item in/not in [...]、distance > >= < <= 数值、state == != resting|moving|liquid
+// 加载时编译为 [物品类别][距离区间][运动状态] 的扁平决策表，运行时只做一次下标查表
+class RuleTable {
+public:
+    // 失败时 error 写明出错的规则序号与原因，表保持为空
+    bool compile(std::vector<std::string> const& rules, std::string& error);
+
+    [[nodiscard]] bool empty() const { return mTable.empty(); }
+    [[nodiscard]] bool usesDistance() const { return !mBounds.empty(); }
+    [[nodiscard]] bool hasPriority() const { return mHasPriority; }
+
+    // 物品类型名 -> 类别，未出现在任何规则中的类型为 0
+    [[nodiscard]] std::uint8_t typeClassOf(std::string_view typeName) const;
+
+    [[nodiscard]] RuleAction evaluate(std::uint8_t typeClass, float distance, ItemMotion motion) const {
+        size_t bucket = 0;
+        while (bucket < mBounds.size() && distance >= mBounds[bucket]) ++bucket;
+        return mTable[(typeClass * mBuckets + bucket) * static_cast<size_t>(ItemMotion::Count)
+                      + static_cast<size_t>(motion)];
+    }
+
+    // 在合成输入上测量单次 evaluate 的平均耗时（纳秒）
+    [[nodiscard]] double benchmarkNs(size_t iterations) const;
+
+    [[nodiscard]] size_t ruleCount() const { return mRuleCount; }
+    [[nodiscard]] size_t tableSize() const { return mTable.size(); }
+
+private:
+    std::unordered_map<std::string, std::uint8_t> mTypeClass;
+    std::vector<float>                            mBounds;
+    std::vector<RuleAction>                       mTable;
+    size_t                                        mClasses     = 0;
+    size_t                                        mBuckets     = 0;
+    size_t                                        mRuleCount   = 0;
+    bool                                          mHasPriority = false;
+};
+
+} // namespace tps_item_optimizer
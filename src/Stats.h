@@ -0,0 +1,92 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace tps_item_optimizer {
+
+// Welford 在线均值/方差
+struct RunningStat {
+    std::uint64_t count = 0;
+    double        mean  = 0.0;
+    double        m2    = 0.0;
+
+    void add(double x) {
+        ++count;
+        double delta  = x - mean;
+        mean         += delta / static_cast<double>(count);
+        m2           += delta * (x - mean);
+    }
+
+    [[nodiscard]] double variance() const { return count > 1 ? m2 / static_cast<double>(count - 1) : 0.0; }
+
+    // 均值 95% 置信区间半宽
+    [[nodiscard]] double ci95() const {
+        return count > 1 ? 1.96 * std::sqrt(variance() / static_cast<double>(count)) : 0.0;
+    }
+
+    void reset() { *this = {}; }
+};
+
+// 两组均值之差的 95% 置信区间半宽
+inline double diffCi95(RunningStat const& a, RunningStat const& b) {
+    if (a.count < 2 || b.count < 2) return 0.0;
+    return 1.96
+         * std::sqrt(a.variance() / static_cast<double>(a.count) + b.variance() / static_cast<double>(b.count));
+}
+
+// Jain 公平性指数：(Σx)² / (n·Σx²)，1 为完全公平
+inline double jainIndex(std::vector<double> const& xs) {
+    double sum = 0.0, sumSq = 0.0;
+    for (double x : xs) {
+        sum   += x;
+        sumSq += x * x;
+    }
+    return sumSq > 0.0 ? sum * sum / (static_cast<double>(xs.size()) * sumSq) : 1.0;
+}
+
+// 基尼系数，0 为完全平均；会对 xs 原地排序
+inline double giniCoefficient(std::vector<double>& xs) {
+    if (xs.empty()) return 0.0;
+    std::sort(xs.begin(), xs.end());
+    double sum = 0.0, weighted = 0.0;
+    for (size_t i = 0; i < xs.size(); ++i) {
+        sum      += xs[i];
+        weighted += static_cast<double>(i + 1) * xs[i];
+    }
+    if (sum <= 0.0) return 0.0;
+    auto n = static_cast<double>(xs.size());
+    return 2.0 * weighted / (n * sum) - (n + 1.0) / n;
+}
+
+// 按 tick 计的线性直方图，每个 tick 一个桶，最后一个桶收纳所有更大的值。
+// SLO 上限被限制在桶范围内，与分位数的比较是精确的
+struct TickHistogram {
+    static constexpr size_t kBuckets = 256;
+
+    std::array<std::uint32_t, kBuckets> buckets{};
+    std::uint64_t                       count = 0;
+
+    void add(std::uint64_t v) {
+        ++buckets[std::min<std::uint64_t>(v, kBuckets - 1)];
+        ++count;
+    }
+
+    // 分位数，落在最后一个桶时返回 kBuckets - 1
+    [[nodiscard]] std::uint64_t percentile(double p) const {
+        if (count == 0) return 0;
+        auto          rank = static_cast<std::uint64_t>(std::ceil(p * static_cast<double>(count)));
+        std::uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) return i;
+        }
+        return kBuckets - 1;
+    }
+
+    void reset() { *this = {}; }
+};
+
+} // namespace tps_item_optimizer
@@ -0,0 +1,212 @@
+#include "SuperStacks.h"
+#include "ChunkKey.h"
+#include "DataFile.h"
+#include "DropLimiter.h"
+#include "Optimizer.h"
+#include <mc/world/item/ItemStack.h>
+#include <mc/world/level/Spawner.h>
+#include <algorithm>
+#include <format>
+#include <unordered_map>
+#include <vector>
+
+namespace tps_item_optimizer {
+
+namespace {
+
+// 数据目录中的旁表文件，每次写回时整体重写
+struct SurplusEntry {
+    std::int64_t  id    = 0;
+    std::uint32_t count = 0;
+};
+
+struct SurplusJournal {
+    int                       version = 1;
+    std::vector<SurplusEntry> stacks;
+};
+
+std::unordered_map<ActorUniqueID, std::uint32_t> surplus;
+bool                                             journalDirty = false;
+int                                              saveElapsed  = 0;
+
+size_t totalAbsorbed   = 0; // 被并入而移除的实体数
+size_t totalHandOver   = 0; // 移除后由新实体接管
+size_t totalSplit      = 0; // 拆出的普通掉落物数
+size_t totalSaveFailed = 0;
+
+std::filesystem::path journalPath() {
+    return Optimizer::getInstance().getSelf().getDataDir() / "super_stacks.json";
+}
+
+bool saveJournal() {
+    SurplusJournal journal;
+    journal.stacks.reserve(surplus.size());
+    for (auto const& [id, count] : surplus) journal.stacks.push_back({id.rawID, count});
+    if (!saveDataFile(journal, journalPath())) {
+        ++totalSaveFailed;
+        return false;
+    }
+    journalDirty = false;
+    return true;
+}
+
+void loadJournal() {
+    SurplusJournal journal;
+    if (!ll::config::loadConfig(journal, journalPath())) return;
+    for (auto const& entry : journal.stacks) {
+        if (entry.count > 0) surplus[ActorUniqueID{entry.id}] += entry.count;
+    }
+}
+
+ItemActor* spawnStack(BlockSource& region, ItemStack const& prototype, int count, Vec3 const& pos) {
+    ItemStack stack = prototype;
+    stack.set(count);
+    setDropLimiterBypass(true);
+    ItemActor* item = region.getLevel().getSpawner().spawnItem(region, stack, nullptr, pos, 0);
+    setDropLimiterBypass(false);
+    return item;
+}
+
+// 返回生成失败而未拆出的数量，由调用方放回旁表
+std::uint32_t split(ItemActor& item, std::uint32_t count) {
+    auto& region = item.getDimensionBlockSource();
+    int   max    = item.item().getMaxStackSize();
+    while (count > 0) {
+        int n = static_cast<int>(std::min<std::uint32_t>(count, static_cast<std::uint32_t>(max)));
+        if (!spawnStack(region, item.item(), n, item.getPosition())) break;
+        count -= static_cast<std::uint32_t>(n);
+        ++totalSplit;
+    }
+    return count;
+}
+
+} // namespace
+
+std::vector<bool> absorbItems(std::vector<std::pair<ItemActor*, ItemActor*>> const& pairs, std::uint32_t limit) {
+    std::vector<bool> absorbed(pairs.size(), false);
+    auto              extraOf = [](ActorUniqueID const& id) -> std::uint32_t {
+        auto found = surplus.find(id);
+        return found != surplus.end() ? found->second : 0;
+    };
+    auto backup = surplus;
+    bool any    = false;
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        auto& [from, into]   = pairs[i];
+        ItemStack const& src = from->item();
+        if (from == into || !into->item().isStackable(src)) continue;
+
+        auto          fromId = from->getOrCreateUniqueID();
+        auto          intoId = into->getOrCreateUniqueID();
+        std::uint32_t moved  = src.mCount + extraOf(fromId);
+        std::uint32_t extra  = extraOf(intoId);
+        if (static_cast<std::uint64_t>(into->item().mCount) + extra + moved > limit) continue;
+
+        // 先摘掉 from 的余量，移除 hook 就不会再为它生成接管实体
+        surplus.erase(fromId);
+        surplus[intoId] = extra + moved;
+        absorbed[i]     = true;
+        any             = true;
+    }
+    if (!any) return absorbed;
+    if (!saveJournal()) {
+        surplus = std::move(backup);
+        absorbed.assign(pairs.size(), false);
+        return absorbed;
+    }
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        if (!absorbed[i]) continue;
+        pairs[i].first->remove();
+        topUpSuperStack(*pairs[i].second);
+        ++totalAbsorbed;
+    }
+    return absorbed;
+}
+
+void setSuperStacksActive(bool active) {
+    saveElapsed = 0;
+    if (active) {
+        if (surplus.empty()) loadJournal();
+    } else if (journalDirty) {
+        saveJournal();
+    }
+}
+
+void updateSuperStacks() {
+    if (!journalDirty || ++saveElapsed < 20) return;
+    saveElapsed = 0;
+    saveJournal();
+}
+
+bool hasSuperStacks() { return !surplus.empty(); }
+
+bool isSuperStack(ActorUniqueID const& id) { return surplus.contains(id); }
+
+void topUpSuperStack(ItemActor& item) {
+    auto found = surplus.find(item.getOrCreateUniqueID());
+    if (found == surplus.end()) return;
+    ItemStack& stack = item.item();
+    int        max   = stack.getMaxStackSize();
+    auto       room  = static_cast<std::uint32_t>(std::max(max - static_cast<int>(stack.mCount), 0));
+    auto       n     = std::min(room, found->second);
+    if (n == 0) return;
+    stack.set(static_cast<int>(stack.mCount + n));
+    found->second -= n;
+    if (found->second == 0) surplus.erase(found);
+    journalDirty = true;
+}
+
+void onSuperStackRemoved(ItemActor& item) {
+    auto found = surplus.find(item.getOrCreateUniqueID());
+    if (found == surplus.end()) return;
+    std::uint32_t count = found->second;
+    surplus.erase(found);
+    journalDirty = true;
+
+    int        max  = item.item().getMaxStackSize();
+    int        n    = static_cast<int>(std::min<std::uint32_t>(count, static_cast<std::uint32_t>(max)));
+    ItemActor* next = spawnStack(item.getDimensionBlockSource(), item.item(), n, item.getPosition());
+    if (!next) return;
+    if (count > static_cast<std::uint32_t>(n)) surplus[next->getOrCreateUniqueID()] = count - n;
+    ++totalHandOver;
+}
+
+void onSuperStackDespawned(ActorUniqueID const& id) {
+    if (surplus.erase(id) > 0) journalDirty = true;
+}
+
+void splitSuperStacksInChunk(BlockSource& region, std::uint64_t chunk) {
+    auto& level = region.getLevel();
+    for (auto it = surplus.begin(); it != surplus.end(); ++it) {
+        // 找不到的实体所在区块未加载，余量留到它再次出现
+        Actor* actor = level.fetchEntity(it->first, false);
+        if (!actor) continue;
+        auto pos = actor->getPosition();
+        if (chunkKeyAt(actor->getDimensionId().id, pos.x, pos.z) != chunk) continue;
+        it->second   = split(static_cast<ItemActor&>(*actor), it->second);
+        journalDirty = true;
+    }
+    std::erase_if(surplus, [](auto const& entry) { return entry.second == 0; });
+}
+
+void splitAllSuperStacks(Level& level) {
+    for (auto& [id, count] : surplus) {
+        Actor* actor = level.fetchEntity(id, false);
+        if (!actor) continue;
+        count        = split(static_cast<ItemActor&>(*actor), count);
+        journalDirty = true;
+    }
+    std::erase_if(surplus, [](auto const& entry) { return entry.second == 0; });
+}
+
+std::string superStackReport() {
+    std::uint64_t items = 0;
+    for (auto const& [id, count] : surplus) items += count;
+    std::string out = std::format(
+        "Super stacks: stacks={}, surplusItems={} | absorbed={}, handOver={}, split={}, saveFailed={}",
+        surplus.size(), items, totalAbsorbed, totalHandOver, totalSplit, totalSaveFailed
+    );
+    totalAbsorbed = totalHandOver = totalSplit = totalSaveFailed = 0;
+    return out;
+}
+
+} // namespace tps_item_optimizer
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <mc/legacy/ActorUniqueID.h>
+#include <mc/world/actor/item/ItemActor.h>
+#include <mc/world/level/BlockSource.h>
+#include <mc/world/level/Level.h>
+
+namespace tps_item_optimizer {
+
+// 超级堆叠：一个掉落物实体在原版堆叠之外再携带 surplus 个相同物品，记录在旁表中。
+// 实体数量低于上限时从 surplus 补满；实体被拾取或吸入而移除时，余量由新生成的实体继续携带。
+// 旁表写入数据目录的 super_stacks.json，实体不在内存中（区块未加载）时余量保留到再次见到它
+
+// 把每对 (from, into) 中的 from（连同其 surplus）并入 into 的 surplus。旁表先写入数据目录，
+// 成功后才移除 from；不可堆叠、超出上限或写入失败的对不做改动。返回每对是否已并入
+std::vector<bool> absorbItems(std::vector<std::pair<ItemActor*, ItemActor*>> const& pairs, std::uint32_t limit);
+
+// 启用时载入数据目录中的旁表（内存中已有时以内存为准）；禁用时写回，内存中的余量保留
+void setSuperStacksActive(bool active);
+
+// 每 tick 调用：补满与接管造成的旁表变化每秒写回一次
+void updateSuperStacks();
+
+bool hasSuperStacks();
+bool isSuperStack(ActorUniqueID const& id);
+
+// 部分拾取或吸入后从 surplus 补满原版堆叠
+void topUpSuperStack(ItemActor& item);
+
+// 实体移除时由新实体接管余量；自然消失时余量随之消失
+void onSuperStackRemoved(ItemActor& item);
+void onSuperStackDespawned(ActorUniqueID const& id);
+
+// 把余量拆成普通掉落物：区块保存前拆该区块的，禁用时拆全部已加载的；未加载的保留在旁表中
+void splitSuperStacksInChunk(BlockSource& region, std::uint64_t chunk);
+void splitAllSuperStacks(Level& level);
+
+std::string superStackReport();
+
+} // namespace tps_item_optimizer
@@ -0,0 +1,301 @@
+#include "VirtualItems.h"
+#include "ChunkKey.h"
+#include "DropLimiter.h"
+#include "JournalWriter.h"
+#include "Optimizer.h"
+#include "SuperStacks.h"
+#include <ll/api/memory/Hook.h>
+#include <mc/nbt/CompoundTag.h>
+#include <mc/world/actor/player/Player.h>
+#include <mc/world/item/ItemStack.h>
+#include <mc/world/level/BlockPos.h>
+#include <mc/world/level/BlockSource.h>
+#include <mc/world/level/Spawner.h>
+#include <mc/world/level/block/Block.h>
+#include <mc/world/level/chunk/ChunkSource.h>
+#include <mc/world/level/chunk/LevelChunk.h>
+#include <mc/world/level/dimension/Dimension.h>
+#include <mc/world/level/storage/SaveContextFactory.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <format>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace tps_item_optimizer {
+
+namespace {
+
+// 虚拟掉落物：只保留物品堆叠与位置，约为实体的几十分之一；id 是记录文件中的行号
+struct VirtualItem {
+    ItemStack     stack;
+    Vec3          pos;
+    std::uint64_t id = 0;
+};
+
+std::unordered_map<std::uint64_t, std::vector<VirtualItem>> records; // 区块键 -> 记录
+std::deque<std::pair<std::uint64_t, VirtualItem>>           pending; // 待还原
+size_t                                                      recordCount = 0;
+int                                                         scanElapsed = 0;
+int                                                         scanCount   = 0;
+std::thread::id                                             serverThread;
+
+// 记录文件：新增在移除实体前写入并等待完成，已还原的墓碑与本批生成同一 tick 交给后台线程
+JournalWriter              journal;
+std::uint64_t              nextId = 1;
+std::vector<std::uint64_t> restoredIds; // 本批已还原、待写墓碑
+
+size_t totalVirtualized   = 0;
+size_t totalRematerialize = 0;
+size_t totalRetained      = 0; // 还原时区块未加载，留作记录
+size_t totalSaveFailed    = 0;
+size_t totalLoadFailed    = 0; // 记录文件中无法解析的物品
+
+std::filesystem::path journalPath() {
+    return Optimizer::getInstance().getSelf().getDataDir() / "virtual_items.log";
+}
+
+// 每条记录一行 JSON，dump 会转义换行
+std::string encodeRecord(std::uint64_t chunk, Vec3 const& pos, std::string snbt) {
+    nlohmann::ordered_json json;
+    json["chunk"] = chunk;
+    json["x"]     = pos.x;
+    json["y"]     = pos.y;
+    json["z"]     = pos.z;
+    json["item"]  = std::move(snbt);
+    return json.dump();
+}
+
+void loadRecord(std::uint64_t id, std::string const& text) {
+    auto json = nlohmann::ordered_json::parse(text, nullptr, false);
+    if (json.is_discarded() || !json.is_object() || !json.contains("chunk") || !json.contains("item")) {
+        ++totalLoadFailed;
+        return;
+    }
+    auto tag = CompoundTag::fromSnbt(json["item"].get<std::string>());
+    if (!tag) {
+        ++totalLoadFailed;
+        return;
+    }
+    Vec3 pos{json["x"].get<float>(), json["y"].get<float>(), json["z"].get<float>()};
+    records[json["chunk"].get<std::uint64_t>()].push_back({ItemStack::fromTag(*tag), pos, id});
+    ++recordCount;
+}
+
+void commitRestored() {
+    if (restoredIds.empty()) return;
+    journal.remove(std::move(restoredIds));
+    restoredIds.clear();
+}
+
+BlockSource* regionOf(Level& level, int dim) {
+    auto dimension = level.getDimension(DimensionType{dim}).lock();
+    return dimension ? &dimension->getBlockSourceFromMainChunkSource() : nullptr;
+}
+
+bool spawnRecord(Level& level, BlockSource& region, VirtualItem const& v) {
+    setDropLimiterBypass(true);
+    ItemActor* item = level.getSpawner().spawnItem(region, v.stack, nullptr, v.pos, 0);
+    setDropLimiterBypass(false);
+    return item != nullptr;
+}
+
+// 还原失败的放回记录，等下次触发
+void restore(Level& level, BlockSource* region, std::uint64_t chunk, VirtualItem&& v) {
+    if (region && spawnRecord(level, *region, v)) {
+        ++totalRematerialize;
+        restoredIds.push_back(v.id);
+        return;
+    }
+    ++totalRetained;
+    records[chunk].push_back(std::move(v));
+    ++recordCount;
+}
+
+void queueChunk(std::unordered_map<std::uint64_t, std::vector<VirtualItem>>::iterator it) {
+    for (auto& v : it->second) pending.emplace_back(it->first, std::move(v));
+    recordCount -= it->second.size();
+}
+
+bool isHopper(BlockSource& region, BlockPos const& pos) {
+    return region.getBlock(pos).getTypeName() == "minecraft:hopper";
+}
+
+} // namespace
+
+void setVirtualItemsActive(bool active) {
+    scanElapsed = 0;
+    if (active) {
+        serverThread = std::this_thread::get_id();
+        for (auto const& [id, text] : journal.start(journalPath())) {
+            loadRecord(id, text);
+            nextId = std::max(nextId, id + 1);
+        }
+        return;
+    }
+    // 记录文件在每次变更时已追加写入，写完排队的墓碑即可清空
+    commitRestored();
+    journal.stop();
+    records.clear();
+    pending.clear();
+    recordCount = 0;
+}
+
+bool virtualizeItems(std::vector<ItemActor*> const& items) {
+    if (items.empty()) return true;
+    auto context = SaveContextFactory::createCloneSaveContext();
+    std::vector<std::uint64_t>        chunks;
+    std::vector<JournalWriter::Entry> entries;
+    chunks.reserve(items.size());
+    entries.reserve(items.size());
+    for (auto* item : items) {
+        auto pos   = item->getPosition();
+        auto chunk = chunkKeyAt(item->getDimensionId().id, pos.x, pos.z);
+        auto id    = nextId++;
+        records[chunk].push_back({item->item(), pos, id});
+        chunks.push_back(chunk);
+        entries.emplace_back(id, encodeRecord(chunk, pos, item->item().save(*context)->toSnbt(SnbtFormat::Minimize)));
+    }
+    recordCount += items.size();
+
+    // 只追加本批记录，不重写整个文件
+    if (!journal.add(std::move(entries))) {
+        ++totalSaveFailed;
+        // 撤销本批记录，实体保持原样
+        for (auto chunk : chunks) {
+            auto found = records.find(chunk);
+            found->second.pop_back();
+            if (found->second.empty()) records.erase(found);
+        }
+        recordCount -= items.size();
+        return false;
+    }
+    for (auto* item : items) item->remove();
+    totalVirtualized += items.size();
+    return true;
+}
+
+void updateVirtualItems(Level& level) {
+    auto const& cfg = getConfig();
+
+    // 分批还原，避免玩家走近时一个 tick 内生成上千实体
+    for (int budget = cfg.rematerializePerTick; budget > 0 && !pending.empty(); --budget) {
+        auto [chunk, v] = std::move(pending.front());
+        pending.pop_front();
+        restore(level, regionOf(level, chunkKeyDim(chunk)), chunk, std::move(v));
+    }
+    commitRestored();
+
+    if (records.empty() || ++scanElapsed < 20) return;
+    scanElapsed = 0;
+
+    std::vector<std::pair<int, Vec3>> players;
+    level.forEachPlayer([&](Player& player) {
+        players.emplace_back(player.getDimensionId().id, player.getPosition());
+        return true;
+    });
+
+    // 区块中心到玩家的水平距离，加上半对角线，保证区块内任意一点都在范围内即触发
+    double near       = cfg.virtualizeDistance - cfg.virtualizeGuard + 11.4;
+    bool   hopperScan = ++scanCount % 5 == 0;
+    for (auto it = records.begin(); it != records.end();) {
+        auto   chunk   = it->first;
+        int    dim     = chunkKeyDim(chunk);
+        double cx      = chunkKeyX(chunk) * 16 + 8;
+        double cz      = chunkKeyZ(chunk) * 16 + 8;
+        bool   trigger = false;
+        for (auto const& [pdim, pos] : players) {
+            double dx = pos.x - cx;
+            double dz = pos.z - cz;
+            if (pdim == dim && dx * dx + dz * dz <= near * near) {
+                trigger = true;
+                break;
+            }
+        }
+        if (!trigger && hopperScan) {
+            if (auto* region = regionOf(level, dim)) {
+                for (auto const& v : it->second) {
+                    BlockPos bp{v.pos};
+                    if (isHopper(*region, bp) || isHopper(*region, BlockPos{bp.x, bp.y - 1, bp.z})) {
+                        trigger = true;
+                        break;
+                    }
+                }
+            }
+        }
+        if (trigger) {
+            queueChunk(it);
+            it = records.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+size_t rematerializeAll(Level& level) {
+    for (auto it = records.begin(); it != records.end(); ++it) queueChunk(it);
+    records.clear();
+    // 还原失败的会放回 records，因此先取出整个队列
+    auto queue = std::move(pending);
+    pending.clear();
+    for (auto& [chunk, v] : queue) restore(level, regionOf(level, chunkKeyDim(chunk)), chunk, std::move(v));
+    commitRestored();
+    return recordCount;
+}
+
+bool hasVirtualItems() { return recordCount > 0 || !pending.empty(); }
+
+std::string virtualItemsReport() {
+    return std::format(
+        "Virtual items: records={}, chunks={}, pending={} | virtualized={}, rematerialized={}, retained={}, "
+        "saveFailed={}, writeFailed={}, loadFailed={}",
+        recordCount, records.size(), pending.size(), totalVirtualized, totalRematerialize, totalRetained,
+        totalSaveFailed, journal.failedWrites(), totalLoadFailed
+    );
+}
+
+} // namespace tps_item_optimizer
+
+// ── 区块保存 Hook：虚拟记录与超级堆叠余量都不在存档中，保存前还原为普通实体。
+// 其他线程上的保存不还原，记录与余量仍在数据目录中，之后照常还原或补满 ──
+LL_AUTO_TYPE_INSTANCE_HOOK(
+    SaveLiveChunkHook,
+    ll::memory::HookPriority::Normal,
+    ChunkSource,
+    &ChunkSource::$saveLiveChunk,
+    bool,
+    LevelChunk& chunk
+) {
+    using namespace tps_item_optimizer;
+
+    if ((!hasVirtualItems() && !hasSuperStacks()) || std::this_thread::get_id() != serverThread) {
+        return origin(chunk);
+    }
+
+    auto& dimension = chunk.getDimension();
+    auto  key       = packChunkKey(dimension.getDimensionId().id, chunk.getPosition().x, chunk.getPosition().z);
+    auto& region    = dimension.getBlockSourceFromMainChunkSource();
+    auto& level     = region.getLevel();
+    if (hasSuperStacks()) splitSuperStacksInChunk(region, key);
+
+    std::vector<VirtualItem> items;
+    if (auto found = records.find(key); found != records.end()) {
+        items        = std::move(found->second);
+        recordCount -= items.size();
+        records.erase(found);
+    }
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (it->first == key) {
+            items.push_back(std::move(it->second));
+            it = pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto& v : items) restore(level, &region, key, std::move(v));
+    commitRestored();
+    return origin(chunk);
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mc/world/actor/item/ItemActor.h>
+#include <mc/world/level/Level.h>
+
+namespace tps_item_optimizer {
+
+// 启用时记录服务器线程并从数据目录载入上次留下的记录；禁用时写完排队的墓碑并清空内存中的记录
+void setVirtualItemsActive(bool active);
+
+// 把掉落物转为所在区块的数据记录：本批记录先追加到数据目录的记录文件，写入完成后才移除实体。
+// 写入失败时不移除任何实体并返回 false
+bool virtualizeItems(std::vector<ItemActor*> const& items);
+
+// 每 tick 调用：分批还原排队的记录，每秒检查玩家接近与漏斗
+void updateVirtualItems(Level& level);
+
+// 立即还原全部记录，返回因区块未加载而仍保留的记录数（已写入数据目录，下次启用时载入）
+size_t rematerializeAll(Level& level);
+
+bool hasVirtualItems();
+
+std::string virtualItemsReport();
+
+} // namespace tps_item_optimizer